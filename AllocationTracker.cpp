@@ -0,0 +1,51 @@
+#include <cstdlib>
+#include <new>
+#include "AllocationTracker.h"
+
+static thread_local AllocationTracker::Counts threadCounts;
+
+ulonglong AllocationTracker::frameBudget = 0;
+
+#ifdef RPG_TRACK_ALLOCATIONS
+void* operator new(size_t size) {
+	threadCounts.allocations++;
+	threadCounts.bytes += size;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+#endif
+
+AllocationTracker::Counts AllocationTracker::Counts::operator-(Counts const& other) const {
+	return { allocations - other.allocations, bytes - other.bytes };
+}
+
+AllocationTracker::Counts& AllocationTracker::Counts::operator+=(Counts const& other) {
+	allocations += other.allocations;
+	bytes += other.bytes;
+	return *this;
+}
+
+AllocationTracker::Counts AllocationTracker::getThreadCounts() noexcept {
+	return threadCounts;
+}
+
+void AllocationTracker::setFrameBudget(ulonglong budget) {
+	if (budget > 0 && !enabled)
+		throw GameError("Allocations are not tracked by this build, define RPG_TRACK_ALLOCATIONS to check a budget");
+	frameBudget = budget;
+}
+
+void AllocationTracker::checkFrameBudget(Counts const& frame) {
+	if (frameBudget > 0 && frame.allocations > frameBudget)
+		throw GameError("Frame made " + std::to_string(frame.allocations) + " allocations (" + std::to_string(frame.bytes)
+			+ " bytes), over the budget of " + std::to_string(frameBudget));
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+/* Counts the heap allocations of each thread through replacements of the global operator new.
+ * The replacements are only compiled in when RPG_TRACK_ALLOCATIONS is defined (the Debug configurations define it, as should builds
+ * used for benchmarks); without it every count stays 0, and enabled tells callers not to report them.
+ */
+class AllocationTracker {
+public:
+#ifdef RPG_TRACK_ALLOCATIONS
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	struct Counts {
+		ulonglong allocations = 0;
+		ulonglong bytes = 0;
+
+		Counts operator-(Counts const& other) const;
+		Counts& operator+=(Counts const& other);
+	};
+
+	//Allocations made by the calling thread since it started; always 0 unless enabled
+	static Counts getThreadCounts() noexcept;
+
+	//Counts the allocations made by the calling thread since its construction; always 0 unless enabled
+	class Scope {
+	public:
+		Scope() : start(getThreadCounts()) {}
+		Counts get() const { return getThreadCounts() - start; }
+
+	private:
+		Counts start;
+	};
+
+	//Allocations allowed in a steady-state frame, checked by checkFrameBudget; 0 disables the check
+	static ulonglong frameBudget;
+	//Throws a GameError for a budget other than 0 unless enabled, as it could not be checked
+	static void setFrameBudget(ulonglong budget);
+	//Throws a GameError if the frame made more allocations than the budget
+	static void checkFrameBudget(Counts const& frame);
+};
@@ -0,0 +1,136 @@
+#include "AtlasBaker.h"
+#include "Resources.h"
+
+//Smallest power of two page able to hold the given number of cell slots
+static uint getPageSize(size_t n_cells, uint slotSize) {
+	uint size = 1;
+	while (size < slotSize || (size_t) (size / slotSize) * (size / slotSize) < n_cells)
+		size *= 2;
+	return size;
+}
+
+void AtlasBaker::bake(std::vector<std::string> const& tileSetNames) {
+	namespace fs = std::filesystem;
+
+	struct Baked {
+		std::string name;
+		std::unique_ptr<TileSet> set;
+		std::vector<sf::Vector2<ushort>> cells;		//Top left corners of the used cells in the source texture
+		size_t page;
+		size_t firstSlot;
+		std::vector<SubTile> subTiles;				//Remapped to the page
+	};
+
+	//Bake from the sources, not from previously baked data; caching is back on however baking ends
+	struct CacheDisabled {
+		bool wasEnabled = TileSet::cacheEnabled;
+		CacheDisabled() { TileSet::cacheEnabled = false; }
+		~CacheDisabled() { TileSet::cacheEnabled = wasEnabled; }
+	} cacheDisabled;
+
+	std::vector<Baked> baked;
+	std::vector<size_t> pageCellCounts;
+	uint tileSize = 0;
+	for (auto const& name : tileSetNames) {
+		Baked& b = baked.emplace_back();
+		b.name = name;
+		// unique_ptr takes control of this new; make_unique cannot be used here due to TileSet's private constructor
+		b.set.reset(new TileSet(name));
+		tileSize = b.set->tileSize;
+
+		std::set<std::pair<ushort, ushort>> seen;
+		for (SubTile const& st : b.set->subTiles) {
+			SubTile::Rect const& rect = SubTile::subPosRects[st.subPosition];
+			sf::Vector2<ushort> cell((ushort) (st.texturePos.x - rect.left * tileSize), (ushort) (st.texturePos.y - rect.top * tileSize));
+			if (seen.insert({ cell.x, cell.y }).second)
+				b.cells.push_back(cell);
+		}
+
+		//Tilesets are drawn from a single texture, so each one is kept whole on a page
+		uint slotSize = tileSize + 2 * padding;
+		size_t capacity = (size_t) (maxPageSize / slotSize) * (maxPageSize / slotSize);
+		if (b.cells.size() > capacity)
+			throw GameError("Tileset " + name + " uses too many cells to fit in a " + std::to_string(maxPageSize) + " atlas page");
+		if (pageCellCounts.empty() || pageCellCounts.back() + b.cells.size() > capacity)
+			pageCellCounts.push_back(0);
+		b.page = pageCellCounts.size() - 1;
+		b.firstSlot = pageCellCounts.back();
+		pageCellCounts.back() += b.cells.size();
+	}
+
+	//Pages are numbered from 0 on every bake, so tilesets baked before into the pages written over are dropped with them
+	std::error_code error;
+	fs::remove_all(Resources::getPath("baked"), error);
+	if (error)
+		throw GameError("Could not empty " + Resources::getPath("baked") + ": " + error.message());
+	fs::create_directories(Resources::getPath("baked"));
+	uint slotSize = tileSize + 2 * padding;
+	std::vector<sf::Image> pages(pageCellCounts.size());
+	for (size_t p = 0; p < pages.size(); p++) {
+		uint size = getPageSize(pageCellCounts[p], slotSize);
+		pages[p].create(size, size, sf::Color::Transparent);
+	}
+
+	for (Baked& b : baked) {
+		//Decoded again from the png: the image of a texture page shared with a loaded tileset is dropped once uploaded
+		sf::Image source;
+		ResourceData png;
+		if (!Resources::load(b.name + ".png", png) || !source.loadFromMemory(png.data, png.size))
+			throw GameError("Could not read the texture of tileset " + b.name);
+		sf::Vector2u sourceSize = source.getSize();
+		if (sourceSize.x == 0 || sourceSize.y == 0)
+			throw GameError("The texture of tileset " + b.name + " is empty");
+		sf::Image& page = pages[b.page];
+		uint slotsPerRow = page.getSize().x / slotSize;
+
+		std::map<std::pair<ushort, ushort>, sf::Vector2<ushort>> remap;	//Source cell -> top left corner of the cell in the page
+		for (size_t c = 0; c < b.cells.size(); c++) {
+			size_t slot = b.firstSlot + c;
+			sf::Vector2<ushort> dest((ushort) ((slot % slotsPerRow) * slotSize + padding), (ushort) ((slot / slotsPerRow) * slotSize + padding));
+			remap[{ b.cells[c].x, b.cells[c].y }] = dest;
+
+			//Copies the cell, extruding its border pixels into the padding
+			int pad = (int) padding;
+			for (int y = -pad; y < (int) tileSize + pad; y++) {
+				for (int x = -pad; x < (int) tileSize + pad; x++) {
+					int sx = std::clamp(b.cells[c].x + std::clamp(x, 0, (int) tileSize - 1), 0, (int) sourceSize.x - 1);
+					int sy = std::clamp(b.cells[c].y + std::clamp(y, 0, (int) tileSize - 1), 0, (int) sourceSize.y - 1);
+					page.setPixel(dest.x + x, dest.y + y, source.getPixel(sx, sy));
+				}
+			}
+		}
+
+		std::vector<SubTile> subTiles = b.set->subTiles;
+		for (SubTile& st : subTiles) {
+			SubTile::Rect const& rect = SubTile::subPosRects[st.subPosition];
+			sf::Vector2<ushort> offset((ushort) (rect.left * tileSize), (ushort) (rect.top * tileSize));
+			sf::Vector2<ushort> dest = remap.at({ (ushort) (st.texturePos.x - offset.x), (ushort) (st.texturePos.y - offset.y) });
+			st.texturePos = sf::Vector2<ushort>(dest.x + offset.x, dest.y + offset.y);
+		}
+
+		b.subTiles = std::move(subTiles);
+	}
+
+	//The caches hold the stamps of their pages, which are written first
+	for (size_t p = 0; p < pages.size(); p++) {
+		std::string filename = Resources::getPath("baked/page" + std::to_string(p) + ".png");
+		if (!pages[p].saveToFile(filename))
+			throw GameError("Could not write atlas page " + filename);
+	}
+	for (Baked const& b : baked) {
+		TileSet::writeCache(Resources::getPath("baked/" + b.name + ".tsb"),
+							TileSet::SourceStamp::of(b.name + ".json", b.name + ".png"),
+							"baked/page" + std::to_string(b.page) + ".png",
+							tileSize, b.set->tiles, b.subTiles);
+	}
+}
+
+int runBakeTool(std::vector<std::string> const& args) {
+	std::vector<std::string> names(args.begin() + 1, args.end());
+	if (names.empty())
+		names = Resources::listTileSets();
+
+	AtlasBaker::bake(names);
+	std::cout << "Baked " << names.size() << " tilesets into " << Resources::getPath("baked") << std::endl;
+	return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "TileSet.h"
+
+/* Offline baker packing the texture cells used by many tilesets into a few shared power-of-two atlas pages.
+ * Cells are padded with their extruded border pixels to avoid bleeding.
+ * Pages and remapped tilesets are written to resources/baked/, emptied first, where TileSet loads them instead of the json.
+ */
+class AtlasBaker {
+public:
+	static void bake(std::vector<std::string> const& tileSetNames);
+
+	static const uint maxPageSize = 2048;
+	static const uint padding = 2;
+};
+
+//Command line baking mode (RPG --bake [tileset...]); bakes every tileset in resources/ if none is given
+int runBakeTool(std::vector<std::string> const& args);
@@ -0,0 +1,757 @@
+#include <iomanip>
+#include "Benchmark.h"
+#include "TileSet.h"
+#include "Scene.h"
+#include "SceneEditor.h"
+#include "FrameCache.h"
+#include "Overdraw.h"
+#include "json.hpp"
+using json = nlohmann::json;
+
+void const* volatile benchmarkSink = nullptr;
+
+namespace {
+	//Values reported by every run of a benchmark, by unit, in the order they were first reported
+	struct Samples {
+		std::string name;
+		//Suite which reported them
+		std::string suite;
+		std::vector<std::pair<std::string, std::vector<double>>> values;
+	};
+
+	std::vector<Samples> samples;
+	std::string currentSuite;
+	//Results are printed as they are reported when the benchmarks run once, and summarized otherwise
+	bool printResults = true;
+
+	void addSample(std::string const& name, std::string const& unit, double value) {
+		auto found = std::find_if(samples.begin(), samples.end(), [&](Samples const& s) { return s.name == name; });
+		if (found == samples.end())
+			found = samples.insert(samples.end(), { name, currentSuite, {} });
+		auto values = std::find_if(found->values.begin(), found->values.end(), [&](auto const& v) { return v.first == unit; });
+		if (values == found->values.end())
+			values = found->values.insert(found->values.end(), { unit, {} });
+		values->second.push_back(value);
+	}
+
+	void report(std::string const& name, double value, std::string const& unit = "ns/op") {
+		addSample(name, unit, value);
+		if (printResults)
+			std::cout << name << ": " << value << ' ' << unit << std::endl;
+	}
+
+	//tilesPerOp is the number of tiles written or read by one call; 0 for operations that do not work on tiles
+	void reportOp(std::string const& name, OpStats const& stats, double tilesPerOp = 0) {
+		std::vector<std::pair<std::string, double>> values = { { "ns/op", stats.nsPerOp } };
+		if (AllocationTracker::enabled)
+			values.push_back({ "allocs/op", stats.allocationsPerOp });
+		if (tilesPerOp > 0)
+			values.push_back({ "tiles/s", tilesPerOp * 1e9 / stats.nsPerOp });
+
+		for (auto const& [unit, value] : values)
+			addSample(name, unit, value);
+		if (printResults) {
+			std::cout << name << ":";
+			for (size_t i = 0; i < values.size(); i++)
+				std::cout << (i == 0 ? " " : ", ") << values[i].second << ' ' << values[i].first;
+			std::cout << std::endl;
+		}
+	}
+
+	void benchmarkLookups() {
+		TileSet const& set = TileSet::get("grasslands");
+		const size_t iterations = 1000000;
+		Tile top = set.getEmptyTile("grass top");
+		Tile wall = set.getEmptyTile("grass wall");
+
+		const SubTile::Pattern patterns[] = { SubTile::center, SubTile::patch, SubTile::cross, SubTile::horizontal, SubTile::vertical };
+		const SubTile::SubPosition corners[] = { SubTile::full, SubTile::tlCorner, SubTile::trCorner, SubTile::blCorner, SubTile::brCorner };
+
+		reportOp("getSubTile(name)", measureOp([&](size_t i) {
+			doNotOptimize(set.getSubTile("grass top", patterns[i % 5], corners[(i / 5) % 5]));
+		}, iterations));
+		reportOp("findSubTile(name)", measureOp([&](size_t i) {
+			doNotOptimize(set.findSubTile("grass top", patterns[i % 5], corners[(i / 5) % 5]));
+		}, iterations));
+
+		reportOp("getSubTile(tile)", measureOp([&](size_t i) {
+			doNotOptimize(set.getSubTile(top, patterns[i % 5], corners[(i / 5) % 5]));
+		}, iterations));
+		reportOp("findSubTile(tile)", measureOp([&](size_t i) {
+			doNotOptimize(set.findSubTile(top, patterns[i % 5], corners[(i / 5) % 5]));
+		}, iterations));
+
+		uint n_subTiles = 0;
+		while (set.findSubTile(n_subTiles) != nullptr)
+			n_subTiles++;
+		reportOp("getSubTile(ID)", measureOp([&](size_t i) {
+			doNotOptimize(set.getSubTile((uint) (i % n_subTiles)));
+		}, iterations));
+		reportOp("findSubTile(ID)", measureOp([&](size_t i) {
+			doNotOptimize(set.findSubTile((uint) (i % n_subTiles)));
+		}, iterations));
+
+		//Failed lookups: the throwing path pays for the message and the unwinding, the other does not
+		const size_t failIterations = 10000;
+		reportOp("getSubTile(tile) miss", measureOp([&](size_t i) {
+			try {
+				doNotOptimize(set.getSubTile(wall, SubTile::patch, SubTile::full, i % 2));
+			}
+			catch (GameError const&) {}
+		}, failIterations));
+		reportOp("findSubTile(tile) miss", measureOp([&](size_t i) {
+			doNotOptimize(set.findSubTile(wall, SubTile::patch, SubTile::full, i % 2));
+		}, failIterations));
+
+		sf::Vector2u size(64, 64);
+		reportOp("indexToCoords", measureOp([&](size_t i) {
+			doNotOptimize(indexToCoords((uint) (i % 4096), size));
+		}, iterations));
+		reportOp("tryIndexToCoords", measureOp([&](size_t i) {
+			doNotOptimize(tryIndexToCoords((uint) (i % 4096), size));
+		}, iterations));
+		reportOp("coordsToIndex", measureOp([&](size_t i) {
+			doNotOptimize(coordsToIndex({ (uint) (i % 64), (uint) (i / 64 % 64) }, size));
+		}, iterations));
+		reportOp("tryCoordsToIndex", measureOp([&](size_t i) {
+			doNotOptimize(tryCoordsToIndex({ (uint) (i % 64), (uint) (i / 64 % 64) }, size));
+		}, iterations));
+	}
+
+	double measureMs(std::function<void()> const& op) {
+		auto start = std::chrono::steady_clock::now();
+		op();
+		auto stop = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::milli>(stop - start).count();
+	}
+
+	//Generates a content pack of tilesets in resources/bench/, each made of many copies of the grasslands tiles
+	std::vector<std::string> generateTileSetPack(size_t n_tileSets, size_t n_copies, std::string const& prefix = "pack") {
+		namespace fs = std::filesystem;
+		std::ifstream ifs("resources/grasslands.json");
+		json source;
+		ifs >> source;
+
+		fs::create_directories("resources/bench");
+		std::vector<std::string> names;
+		for (size_t i = 0; i < n_tileSets; i++) {
+			json pack = json::object();
+			for (size_t c = 0; c < n_copies; c++) {
+				std::string suffix = ' ' + std::to_string(c);
+				for (auto& [tileName, jTile] : source.items()) {
+					json copy = jTile;
+					for (auto& [category, compatName] : copy["compatibility"].items()) {
+						compatName = compatName.get<std::string>() + suffix;
+					}
+					pack[tileName + suffix] = copy;
+				}
+			}
+			std::string name = "bench/" + prefix + std::to_string(i);
+			std::ofstream("resources/" + name + ".json") << pack.dump(1, '\t');
+			fs::copy_file("resources/grasslands.png", "resources/" + name + ".png", fs::copy_options::overwrite_existing);
+			names.push_back(name);
+		}
+		return names;
+	}
+
+	void benchmarkTileSetLoading() {
+		const size_t n_tileSets = 50;
+		std::vector<std::string> names = generateTileSetPack(n_tileSets, 40);
+
+		auto loadAll = [&]() {
+			for (auto const& name : names)
+				TileSet::get(name);
+			TileSet::unload_all();
+		};
+
+		TileSet::cacheEnabled = false;
+		report("load " + std::to_string(n_tileSets) + " tilesets, json only", measureMs(loadAll), "ms");
+		TileSet::cacheEnabled = true;
+		report("load " + std::to_string(n_tileSets) + " tilesets, json + cache write", measureMs(loadAll), "ms");
+		report("load " + std::to_string(n_tileSets) + " tilesets, from cache", measureMs(loadAll), "ms");
+
+		auto loadAllAsync = [&]() {
+			std::vector<TileSet::Request> requests;
+			for (auto const& name : names)
+				requests.push_back(TileSet::getAsync(name));
+			for (auto const& request : requests)
+				request.get();
+			TileSet::unload_all();
+		};
+
+		TileSet::cacheEnabled = false;
+		report("load " + std::to_string(n_tileSets) + " tilesets in parallel, json only", measureMs(loadAllAsync), "ms");
+		TileSet::cacheEnabled = true;
+		report("load " + std::to_string(n_tileSets) + " tilesets in parallel, from cache", measureMs(loadAllAsync), "ms");
+
+		std::filesystem::remove_all("resources/bench");
+	}
+
+	//Parse throughput of the streaming tileset loader on one large file, with a full DOM parse for reference
+	void benchmarkTileSetParsing() {
+		std::string name = generateTileSetPack(1, 20000, "large")[0];
+		std::string filename = "resources/" + name + ".json";
+		double megabytes = std::filesystem::file_size(filename) / 1e6;
+
+		TileSet::cacheEnabled = false;
+		double ms = measureMs([&]() {
+			TileSet::get(name);
+			TileSet::unload_all();
+		});
+		TileSet::cacheEnabled = true;
+		report("streaming tileset load (" + std::to_string((int) megabytes) + " MB)", megabytes / ms * 1000, "MB/s");
+
+		ms = measureMs([&]() {
+			std::ifstream ifs(filename);
+			json j;
+			ifs >> j;
+			doNotOptimize(j);
+		});
+		report("json DOM parse only (" + std::to_string((int) megabytes) + " MB)", megabytes / ms * 1000, "MB/s");
+
+		std::filesystem::remove_all("resources/bench");
+	}
+
+	//Save and load of a 1000x1000 scene of grass tops on rolling heights, built without autotiling
+	//Covers size * size columns with one tile each, at heights varying by blocks of 10 columns
+	void fillScene(Scene& scene, int size) {
+		TileSet const& set = scene.getTileSet();
+		Tile top = set.getEmptyTile("grass top");
+		top.subTiles.push_back(set.getSubTile(top));
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				scene.setTile(top, x, y, (x / 10 + y / 10) % 4);
+			}
+		}
+	}
+
+	//Random accesses to a 256x256 scene of grass tops; the coordinates are drawn in advance
+	void benchmarkSceneAccess() {
+		TileSet const& set = TileSet::get("grasslands");
+		Scene scene(set);
+		const int size = 256;
+		fillScene(scene, size);
+
+		std::vector<sf::Vector2i> coords(4096);
+		for (auto& c : coords)
+			c = sf::Vector2i(rand() % size, rand() % size);
+		auto heightAt = [](sf::Vector2i c) { return (c.x / 10 + c.y / 10) % 4; };
+
+		Tile top = set.getEmptyTile("grass top");
+		top.subTiles.push_back(set.getSubTile(top));
+		const size_t iterations = 1000000;
+		//Tiles are rewritten with the value they already hold, so that every iteration does the same work
+		reportOp("Scene::setTile", measureOp([&](size_t i) {
+			sf::Vector2i c = coords[i % coords.size()];
+			scene.setTile(top, c.x, c.y, heightAt(c));
+		}, iterations), 1);
+		reportOp("Scene::getTile", measureOp([&](size_t i) {
+			sf::Vector2i c = coords[i % coords.size()];
+			doNotOptimize(scene.getTile(c.x, c.y, heightAt(c)));
+		}, iterations), 1);
+		reportOp("Scene::getTile miss", measureOp([&](size_t i) {
+			sf::Vector2i c = coords[i % coords.size()];
+			doNotOptimize(scene.getTile(c.x, c.y, 10));
+		}, iterations), 1);
+		reportOp("Scene::getHighestTileHeight", measureOp([&](size_t i) {
+			sf::Vector2i c = coords[i % coords.size()];
+			doNotOptimize(scene.getHighestTileHeight(c.x, c.y));
+		}, iterations), 1);
+		reportOp("Scene::getLowestTileHeight", measureOp([&](size_t i) {
+			sf::Vector2i c = coords[i % coords.size()];
+			doNotOptimize(scene.getLowestTileHeight(c.x, c.y));
+		}, iterations), 1);
+	}
+
+	//Exposes the autotiling of a single tile
+	class FillTool : public SceneEditionTool {
+	public:
+		virtual bool use(int x, int y, int z) const {
+			setFilledTile("grass top", x, y, z);
+			return true;
+		}
+	};
+
+	//Terrain editing on a 128x128 area, for several height maps
+	void benchmarkTerrainEditing() {
+		TileSet const& set = TileSet::get("grasslands");
+		const int size = 128;
+
+		const std::pair<std::string, std::function<int(int, int)>> terrains[] = {
+			{ "flat", [](int, int) { return 0; } },
+			{ "noisy", [](int x, int y) { return (int) (((uint) x * 73856093u ^ (uint) y * 19349663u) % 4); } },
+			{ "cliffs", [](int x, int y) { return (x / 8 + y / 8) % 2 * 6; } },
+		};
+
+		for (auto const& [terrain, heightAt] : terrains) {
+			Scene scene(set);
+			TerrainTool tool;
+			tool.setScene(scene);
+			tool.top = "grass top";
+			tool.wall = "grass wall";
+			tool.foot = "grass foot";
+
+			//Every column holds a top and walls down to height 0
+			double tiles = 0;
+			for (int i = 0; i < size * size; i++)
+				tiles += heightAt(i % size, i / size) + 1;
+
+			OpStats stats = measureOp([&](size_t i) {
+				int x = (int) i % size, y = (int) i / size;
+				tool.use(x, y, heightAt(x, y));
+			}, size * size);
+			reportOp("TerrainTool::use, " + terrain, stats, tiles / (size * size));
+
+			//Walls hidden behind the tops and walls in front of them are left out of the meshes
+			scene.drawHeadless(sf::View(sf::FloatRect(0, 0, (float) size, (float) size)));
+			Scene::DrawStatistics const& drawn = scene.getDrawStatistics();
+			report("subtiles occluded, " + terrain, 100.0 * drawn.occluded / std::max<size_t>(drawn.subTiles + drawn.occluded, 1), "%");
+
+			//Autotiling the tops again once the terrain is complete
+			FillTool fill;
+			fill.setScene(scene);
+			reportOp("SceneEditionTool::setFilledTile, " + terrain, measureOp([&](size_t i) {
+				int x = (int) i % size, y = (int) (i / size) % size;
+				fill.use(x, y, heightAt(x, y));
+			}, 4 * size * size), 1);
+		}
+	}
+
+	//Drawing the view of the game over a 1M tile scene. Without a render target, only the work done on the CPU is measured:
+	//culling, unpacking and meshing the chunks.
+	void benchmarkRendering() {
+		TileSet const& set = TileSet::get("grasslands");
+		Scene scene(set);
+		const int size = 1000;
+		fillScene(scene, size);
+		//As in a long session, chunks out of view are packed
+		scene.packIdleChunks(0);
+		sf::View view(sf::FloatRect(0, 0, 17, 10));
+		scene.drawHeadless(view);
+
+		reportOp("Scene::drawHeadless, steady", measureOp([&](size_t) {
+			scene.drawHeadless(view);
+		}, 200));
+
+		Tile top = set.getEmptyTile("grass top");
+		top.subTiles.push_back(set.getSubTile(top));
+		reportOp("Scene::drawHeadless, after an edit", measureOp([&](size_t i) {
+			//Same height as fillScene
+			int x = 2 + (int) i % 12;
+			scene.setTile(top, x, 4, (x / 10) % 4);
+			scene.drawHeadless(view);
+		}, 200));
+
+		//A new column of chunks comes into view every few frames
+		reportOp("Scene::drawHeadless, panning", measureOp([&](size_t i) {
+			view.setCenter(8.5f + (float) (i % (size - 17)), 5);
+			scene.drawHeadless(view);
+		}, size - 17));
+
+		//Run with LIBGL_ALWAYS_SOFTWARE=1 for numbers that do not depend on the graphics card
+		sf::RenderTexture target;
+		if (!target.create(1600, 900)) {
+			if (printResults)
+				std::cout << "No GL context, skipping offscreen drawing" << std::endl;
+			return;
+		}
+		view.setCenter(8.5f, 5);
+		target.setView(view);
+		reportOp("Scene draw to a 1600x900 texture", measureOp([&](size_t) {
+			target.clear();
+			target.draw(scene);
+			target.display();
+		}, 200));
+
+		//The same frame drawn with one pixel per pixel of the tiles, then upscaled
+		FrameCache frame;
+		frame.setScale(4);
+		reportOp("Scene draw at 1/4 resolution, upscaled to 1600x900", measureOp([&](size_t) {
+			frame.invalidate();
+			frame.update(scene, view, target.getSize(), sf::Color::Black);
+			target.clear();
+			target.draw(frame);
+			target.display();
+		}, 200));
+
+		OverdrawHeatmap heatmap;
+		if (heatmap.update(scene, view, target.getSize())) {
+			report("overdraw, per covered pixel", heatmap.getStatistics().perCoveredPixel, "fragments/pixel");
+			report("overdraw, max", heatmap.getStatistics().max, "fragments/pixel");
+		}
+
+		//An edit on a still view, only the tiles set being drawn again
+		frame.setScale(1);
+		frame.update(scene, view, target.getSize(), sf::Color::Black);
+		reportOp("Scene edit redrawn by FrameCache, 1600x900", measureOp([&](size_t i) {
+			int x = 2 + (int) i % 12;
+			scene.setTile(top, x, 4, (x / 10) % 4);
+			frame.update(scene, view, target.getSize(), sf::Color::Black);
+			target.clear();
+			target.draw(frame);
+			target.display();
+		}, 200));
+	}
+
+	void benchmarkSceneFile() {
+		TileSet const& set = TileSet::get("grasslands");
+		Scene scene(set);
+		const int size = 1000;
+		fillScene(scene, size);
+
+		std::string filename = "bench.scene";
+		report("save 1M tile scene", measureMs([&]() { scene.save(filename); }), "ms");
+		report("scene file size", std::filesystem::file_size(filename) / 1e6, "MB");
+
+		Scene loaded(set);
+		report("load 1M tile scene", measureMs([&]() { loaded.load(filename); }), "ms");
+		for (int i = 0; i < 1000; i++) {
+			int x = rand() % size, y = rand() % size;
+			if (loaded.getHighestTileHeight(x, y) != scene.getHighestTileHeight(x, y))
+				throw GameError("Loaded scene differs from the saved one at " + vec2ToString(sf::Vector2i(x, y)));
+		}
+		std::filesystem::remove(filename);
+	}
+
+	void benchmarkMemory() {
+		TileSet const& set = TileSet::get("grasslands");
+		Scene scene(set);
+		fillScene(scene, 1000);
+
+		MemoryReport memory = scene.getMemoryReport();
+		memory += TileSet::getLoadedMemoryReport();
+		for (int i = 0; i < MemoryReport::n_categories; i++)
+			report(std::string("1M tile scene memory, ") + MemoryReport::getCategoryName((MemoryReport::Category) i), memory.bytes[i] / 1e6, "MB");
+		report("1M tile scene memory, total", memory.getTotal() / 1e6, "MB");
+		for (size_t i = 0; i < memory.chunkHistogram.size(); i++) {
+			if (memory.chunkHistogram[i] > 0)
+				report("chunks of " + std::to_string((size_t) 1 << i) + "+ bytes", (double) memory.chunkHistogram[i], "chunks");
+		}
+	}
+
+	void benchmarkChunkPacking() {
+		TileSet const& set = TileSet::get("grasslands");
+		Scene scene(set);
+		const int size = 1000;
+		fillScene(scene, size);
+
+		std::vector<int> heights(size * size);
+		for (int i = 0; i < size * size; i++)
+			heights[i] = scene.getHighestTileHeight(i % size, i / size);
+
+		report("pack 1M tile scene", measureMs([&]() { scene.packIdleChunks(0); }), "ms");
+		MemoryReport memory = scene.getMemoryReport();
+		report("packed chunks", (double) memory.packedChunkCount, "chunks");
+		report("packed size", memory.bytes[MemoryReport::packedChunks] / 1e6, "MB");
+		report("size before packing", memory.packedSourceBytes / 1e6, "MB");
+
+		//Every access to a packed chunk unpacks it
+		report("unpack on access", measureMs([&]() {
+			for (int i = 0; i < size * size; i++) {
+				if (scene.getHighestTileHeight(i % size, i / size) != heights[i])
+					throw GameError("Unpacked scene differs at " + vec2ToString(sf::Vector2i(i % size, i / size)));
+			}
+		}), "ms");
+		memory = scene.getMemoryReport();
+		report("unpacked size", (memory.bytes[MemoryReport::tileStorage] + memory.bytes[MemoryReport::subTileVectors]) / 1e6, "MB");
+	}
+
+	void benchmarkAutosave() {
+		TileSet const& set = TileSet::get("grasslands");
+		Scene scene(set);
+		const int size = 3163;
+		fillScene(scene, size);
+		scene.packIdleChunks(0);
+
+		std::string filename = "bench.scene";
+		report("start autosave of 10M tile scene", measureMs([&]() { scene.saveAsync(filename); }), "ms");
+
+		//The first edit of a row or chunk still shared with the save copies it
+		Tile top = set.getEmptyTile("grass top");
+		top.subTiles.push_back(set.getSubTile(top));
+		std::vector<double> editTimes;
+		auto start = std::chrono::steady_clock::now();
+		while (scene.isSaving()) {
+			int x = rand() % size, y = rand() % size;
+			editTimes.push_back(measureMs([&]() { scene.setTile(top, x, y, 5); }));
+		}
+		report("autosave of 10M tile scene", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), "ms");
+
+		std::sort(editTimes.begin(), editTimes.end());
+		if (!editTimes.empty()) {
+			report("edits during autosave", (double) editTimes.size(), "edits");
+			report("edit during autosave, 99th percentile", editTimes[editTimes.size() * 99 / 100], "ms");
+			report("edit during autosave, slowest", editTimes.back(), "ms");
+		}
+		std::filesystem::remove(filename);
+	}
+
+	struct Statistics {
+		double median;
+		//Median absolute deviation from the median, a measure of the spread that ignores outliers
+		double mad;
+	};
+
+	double median(std::vector<double> values) {
+		std::sort(values.begin(), values.end());
+		size_t n = values.size();
+		return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+	}
+
+	Statistics computeStatistics(std::vector<double> const& values) {
+		double m = median(values);
+		std::vector<double> deviations;
+		for (double v : values)
+			deviations.push_back(std::abs(v - m));
+		return { m, median(deviations) };
+	}
+
+	json toJson(std::vector<Samples> const& results) {
+		json j = json::array();
+		for (Samples const& result : results) {
+			json jResult = { { "name", result.name }, { "suite", result.suite } };
+			for (auto const& [unit, values] : result.values) {
+				Statistics stats = computeStatistics(values);
+				jResult[unit] = { { "median", stats.median }, { "mad", stats.mad } };
+			}
+			j.push_back(jResult);
+		}
+		return j;
+	}
+
+	bool writeJson(json const& j, std::string const& filename) {
+		std::ofstream ofs(filename);
+		ofs << j.dump(1, '\t') << std::endl;
+		if (!ofs.good()) {
+			std::cerr << "Could not write " << filename << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	//Relative change allowed before a metric counts as a regression, unless the baseline sets its own; negative for metrics that are not compared
+	double getDefaultThreshold(std::string const& unit) {
+		if (unit == "ns/op" || unit == "tiles/s" || unit == "ms" || unit == "MB/s")
+			return 0.25;
+		if (unit == "allocs/op" || unit == "MB" || unit == "fragments/pixel")
+			return 0.05;
+		return -1;
+	}
+
+	bool isHigherBetter(std::string const& unit) {
+		return unit.size() > 2 && unit.compare(unit.size() - 2, 2, "/s") == 0;
+	}
+
+	/* Compares the medians of the results with those of a baseline file written by --save-baseline. A metric regresses when it
+	 * got worse by more than its threshold, and by more than three times the spread of the measures so that noise alone does not fail.
+	 * Per-metric thresholds can be set in the baseline: "thresholds": { "<benchmark>": { "<unit>": <relative change> } }.
+	 * Compared metrics of the suites run which are in only one of the results and the baseline fail too, as they were not: a GL
+	 * context missing on one side, a renamed benchmark or a baseline recorded before a benchmark was added. Allocation counts are
+	 * left out when either side did not track them.
+	 * Returns the number of regressions and missing metrics.
+	 */
+	int compareWithBaseline(std::string const& filename, std::set<std::string> const& suitesRun, bool allSuites) {
+		std::ifstream ifs(filename);
+		if (!ifs.is_open())
+			throw GameError("Could not open benchmark baseline " + filename);
+		json baseline;
+		ifs >> baseline;
+		json const& thresholds = baseline.contains("thresholds") ? baseline["thresholds"] : json::object();
+		//Baselines written before suites were recorded only say which benchmarks they hold
+		std::set<std::string> baselineSuites;
+		if (baseline.contains("suites"))
+			baselineSuites = baseline["suites"].get<std::set<std::string>>();
+		bool baselineAllocations = baseline.value("allocationsTracked", true);
+		auto getThreshold = [&](std::string const& name, std::string const& unit) {
+			if (thresholds.contains(name) && thresholds[name].contains(unit))
+				return thresholds[name][unit].get<double>();
+			return getDefaultThreshold(unit);
+		};
+
+		std::map<std::string, json const*> baselineResults;
+		for (json const& jResult : baseline.at("benchmarks"))
+			baselineResults[jResult.at("name").get<std::string>()] = &jResult;
+
+		int regressions = 0, missing = 0;
+		std::ostringstream diff;
+		diff.precision(4);
+		diff << std::left << std::setw(48) << "benchmark" << std::setw(16) << "metric" << std::setw(22) << "baseline"
+			<< std::setw(22) << "current" << "change" << std::endl;
+		for (Samples const& result : samples) {
+			auto found = baselineResults.find(result.name);
+			for (auto const& [unit, values] : result.values) {
+				Statistics current = computeStatistics(values);
+				diff << std::setw(48) << result.name << std::setw(16) << unit;
+				std::ostringstream currentText;
+				currentText.precision(4);
+				currentText << current.median << " +-" << current.mad;
+				if (found == baselineResults.end() || !found->second->contains(unit)) {
+					diff << std::setw(22) << "-" << std::setw(22) << currentText.str();
+					if (baselineSuites.count(result.suite) && getThreshold(result.name, unit) >= 0 && (unit != "allocs/op" || baselineAllocations)) {
+						diff << "NOT IN BASELINE" << std::endl;
+						missing++;
+					}
+					else {
+						diff << "new" << std::endl;
+					}
+					continue;
+				}
+				json const& jBase = found->second->at(unit);
+				Statistics base{ jBase.at("median").get<double>(), jBase.at("mad").get<double>() };
+				std::ostringstream baseText;
+				baseText.precision(4);
+				baseText << base.median << " +-" << base.mad;
+				diff << std::setw(22) << baseText.str() << std::setw(22) << currentText.str();
+
+				double change = base.median != 0 ? (current.median - base.median) / base.median : (current.median != 0 ? 1 : 0);
+				diff << std::showpos << change * 100 << std::noshowpos << '%';
+
+				double threshold = getThreshold(result.name, unit);
+				double worse = isHigherBetter(unit) ? -change : change;
+				double noise = 3 * (base.mad + current.mad);
+				if (threshold >= 0 && worse > threshold && std::abs(current.median - base.median) > noise) {
+					diff << "  REGRESSION (threshold " << threshold * 100 << "%)";
+					regressions++;
+				}
+				diff << std::endl;
+			}
+		}
+
+		//Metrics of the baseline the run did not report
+		for (json const& jResult : baseline.at("benchmarks")) {
+			std::string name = jResult.at("name").get<std::string>();
+			auto result = std::find_if(samples.begin(), samples.end(), [&](Samples const& s) { return s.name == name; });
+			for (auto const& [unit, jBase] : jResult.items()) {
+				if (!jBase.is_object())
+					continue;
+				if (result != samples.end()
+					&& std::any_of(result->values.begin(), result->values.end(), [&](auto const& v) { return v.first == unit; }))
+					continue;
+
+				std::ostringstream baseText;
+				baseText.precision(4);
+				baseText << jBase.at("median").get<double>() << " +-" << jBase.at("mad").get<double>();
+				diff << std::setw(48) << name << std::setw(16) << unit << std::setw(22) << baseText.str() << std::setw(22) << "-";
+				bool suiteRun = jResult.contains("suite") ? suitesRun.count(jResult["suite"].get<std::string>()) > 0 : allSuites;
+				if (unit == "allocs/op" && !AllocationTracker::enabled) {
+					diff << "not tracked" << std::endl;
+				}
+				else if (!suiteRun) {
+					diff << "not run" << std::endl;
+				}
+				else if (getThreshold(name, unit) < 0) {
+					diff << "not compared" << std::endl;
+				}
+				else {
+					diff << "MISSING" << std::endl;
+					missing++;
+				}
+			}
+		}
+
+		std::cout << diff.str();
+		std::cout << regressions << " regression" << (regressions == 1 ? "" : "s") << ", " << missing << " missing metric"
+			<< (missing == 1 ? "" : "s") << " against " << filename << std::endl;
+		if (!AllocationTracker::enabled)
+			std::cout << "Allocations are not tracked by this build, define RPG_TRACK_ALLOCATIONS to compare them" << std::endl;
+		return regressions + missing;
+	}
+}
+
+int runBenchmarks(std::vector<std::string> const& args) {
+	const std::vector<std::pair<std::string, void(*)()>> suites = {
+		{ "lookups", benchmarkLookups },
+		{ "scene", benchmarkSceneAccess },
+		{ "terrain", benchmarkTerrainEditing },
+		{ "render", benchmarkRendering },
+		{ "tilesets", benchmarkTileSetLoading },
+		{ "parsing", benchmarkTileSetParsing },
+		{ "file", benchmarkSceneFile },
+		{ "memory", benchmarkMemory },
+		{ "packing", benchmarkChunkPacking },
+		{ "autosave", benchmarkAutosave },
+	};
+
+	std::string jsonFile, baselineFile, newBaselineFile;
+	int repeat = 1;
+	std::set<std::string> selected;
+	for (size_t i = 1; i < args.size(); i++) {
+		bool hasValue = i + 1 < args.size();
+		if (args[i] == "--json" && hasValue) {
+			jsonFile = args[++i];
+		}
+		else if (args[i] == "--repeat" && hasValue) {
+			repeat = std::max(1, std::stoi(args[++i]));
+		}
+		else if (args[i] == "--compare" && hasValue) {
+			baselineFile = args[++i];
+		}
+		else if (args[i] == "--save-baseline" && hasValue) {
+			newBaselineFile = args[++i];
+		}
+		else if (std::none_of(suites.begin(), suites.end(), [&](auto const& suite) { return suite.first == args[i]; })) {
+			std::cerr << "Unknown benchmark suite " << args[i]
+				<< ". Usage: --bench [--repeat <n>] [--json <file>] [--compare <baseline>] [--save-baseline <file>] [suite...], with suites:";
+			for (auto const& suite : suites)
+				std::cerr << ' ' << suite.first;
+			std::cerr << std::endl;
+			return 1;
+		}
+		else {
+			selected.insert(args[i]);
+		}
+	}
+
+	std::set<std::string> suitesRun;
+	for (auto const& suite : suites) {
+		if (selected.empty() || selected.count(suite.first))
+			suitesRun.insert(suite.first);
+	}
+
+	printResults = repeat == 1;
+	for (int i = 0; i < repeat; i++) {
+		if (repeat > 1)
+			std::cout << "run " << i + 1 << '/' << repeat << std::endl;
+		for (auto const& [name, run] : suites) {
+			if (suitesRun.count(name)) {
+				currentSuite = name;
+				run();
+			}
+		}
+	}
+	TileSet::unload_all();
+
+	if (repeat > 1 && baselineFile.empty()) {
+		for (Samples const& result : samples) {
+			std::cout << result.name << ":";
+			for (size_t i = 0; i < result.values.size(); i++) {
+				Statistics stats = computeStatistics(result.values[i].second);
+				std::cout << (i == 0 ? " " : ", ") << stats.median << " +-" << stats.mad << ' ' << result.values[i].first;
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	json results = toJson(samples);
+	if (!jsonFile.empty() && !writeJson({ { "benchmarks", results } }, jsonFile))
+		return 1;
+
+	//Thresholds set by hand in a previous baseline are kept
+	if (!newBaselineFile.empty()) {
+		json thresholds = json::object();
+		std::ifstream previous(newBaselineFile);
+		if (previous.is_open()) {
+			json old;
+			previous >> old;
+			if (old.contains("thresholds"))
+				thresholds = old["thresholds"];
+		}
+		json baseline = { { "suites", suitesRun }, { "allocationsTracked", AllocationTracker::enabled }, { "thresholds", thresholds }, { "benchmarks", results } };
+		if (!writeJson(baseline, newBaselineFile))
+			return 1;
+	}
+
+	if (!baselineFile.empty() && compareWithBaseline(baselineFile, suitesRun, selected.empty()) > 0)
+		return 1;
+	return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include "AllocationTracker.h"
+
+//Command line benchmark mode: RPG --bench [--json <file>] [suite...]
+int runBenchmarks(std::vector<std::string> const& args);
+
+extern void const* volatile benchmarkSink;
+
+//Keeps the compiler from optimizing away a benchmarked result
+template<class T>
+inline void doNotOptimize(T const& value) {
+	benchmarkSink = &value;
+}
+
+struct OpStats {
+	double nsPerOp;
+	double allocationsPerOp;
+};
+
+//Runs op the given number of times and returns the average time and number of allocations per call (0 unless AllocationTracker::enabled)
+template<class F>
+OpStats measureOp(F&& op, size_t iterations) {
+	AllocationTracker::Scope allocations;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		op(i);
+	}
+	auto stop = std::chrono::steady_clock::now();
+	return { (double) std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count() / iterations, (double) allocations.get().allocations / iterations };
+}
@@ -0,0 +1,115 @@
+#include "Binary.h"
+
+void BinaryWriter::writeString(std::string const& s) {
+	write((uint) s.size());
+	append(s.data(), s.size());
+}
+
+void BinaryWriter::append(void const* data, size_t size) {
+	char const* bytes = static_cast<char const*>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void BinaryWriter::writeVarint(ulonglong value) {
+	while (value >= 0x80) {
+		buffer.push_back((char) (value | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back((char) value);
+}
+
+void BinaryWriter::writeSignedVarint(longlong value) {
+	writeVarint(((ulonglong) value << 1) ^ (ulonglong) (value >> 63));
+}
+
+void BinaryWriter::clear() {
+	buffer.clear();
+}
+
+std::vector<char> const& BinaryWriter::getBuffer() const {
+	return buffer;
+}
+
+size_t BinaryWriter::size() const {
+	return buffer.size();
+}
+
+bool BinaryWriter::saveToFile(std::string const& filename) const {
+	std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+	if (!ofs.is_open())
+		return false;
+	ofs.write(buffer.data(), buffer.size());
+	return ofs.good();
+}
+
+BinaryReader::BinaryReader(char const* data, size_t size) : data(data), size(size) {}
+
+std::string BinaryReader::readString() {
+	uint length = read<uint>();
+	char const* chars = skip(length);
+	return std::string(chars, length);
+}
+
+ulonglong BinaryReader::readVarint() {
+	ulonglong value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (pos == size)
+			throw GameError("Unexpected end of binary data (reading varint at offset " + std::to_string(pos) + ')');
+		uchar byte = (uchar) data[pos++];
+		value |= (ulonglong) (byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+	throw GameError("Invalid varint in binary data at offset " + std::to_string(pos));
+}
+
+longlong BinaryReader::readSignedVarint() {
+	ulonglong value = readVarint();
+	return (longlong) (value >> 1) ^ -(longlong) (value & 1);
+}
+
+char const* BinaryReader::skip(size_t n) {
+	if (n > size - pos)
+		throw GameError("Unexpected end of binary data (reading " + std::to_string(n) + " bytes at offset " + std::to_string(pos) + " of " + std::to_string(size) + ')');
+	char const* p = data + pos;
+	pos += n;
+	return p;
+}
+
+size_t BinaryReader::tell() const {
+	return pos;
+}
+
+size_t BinaryReader::remaining() const {
+	return size - pos;
+}
+
+void BinaryReader::seek(size_t pos) {
+	if (pos > size)
+		throw GameError("Tried to seek past the end of binary data (offset " + std::to_string(pos) + " of " + std::to_string(size) + ')');
+	this->pos = pos;
+}
+
+bool BinaryReader::atEnd() const {
+	return pos == size;
+}
+
+uint checksum32(void const* data, size_t size, uint previous) {
+	uchar const* bytes = static_cast<uchar const*>(data);
+	uint hash = previous;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+bool readWholeFile(std::string const& filename, std::vector<char>& out) {
+	std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+	if (!ifs.is_open())
+		return false;
+	out.resize((size_t) ifs.tellg());
+	ifs.seekg(0);
+	ifs.read(out.data(), out.size());
+	return ifs.good();
+}
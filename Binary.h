@@ -0,0 +1,79 @@
+#pragma once
+
+//Helpers for the game's binary file formats. Values are stored in native byte order.
+
+class BinaryWriter {
+public:
+	template<class T>
+	void write(T const& value) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written as raw bytes");
+		append(&value, sizeof(T));
+	}
+
+	template<class T>
+	void writeArray(T const* values, size_t count) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written as raw bytes");
+		append(values, sizeof(T) * count);
+	}
+
+	void writeString(std::string const& s);
+	void append(void const* data, size_t size);
+
+	//LEB128 variable length integers; signed values are zigzag encoded so that small magnitudes stay short
+	void writeVarint(ulonglong value);
+	void writeSignedVarint(longlong value);
+
+	void clear();
+
+	std::vector<char> const& getBuffer() const;
+	size_t size() const;
+
+	bool saveToFile(std::string const& filename) const;
+
+private:
+	std::vector<char> buffer;
+};
+
+//Bounds-checked reader over a memory buffer; throws GameError when reading past the end
+class BinaryReader {
+public:
+	BinaryReader(char const* data, size_t size);
+
+	template<class T>
+	T read() {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be read as raw bytes");
+		T value;
+		std::memcpy(&value, skip(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	template<class T>
+	void readArray(T* values, size_t count) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be read as raw bytes");
+		std::memcpy(values, skip(sizeof(T) * count), sizeof(T) * count);
+	}
+
+	std::string readString();
+
+	ulonglong readVarint();
+	longlong readSignedVarint();
+
+	//Returns a pointer to the skipped bytes
+	char const* skip(size_t n);
+
+	size_t tell() const;
+	size_t remaining() const;
+	void seek(size_t pos);
+	bool atEnd() const;
+
+private:
+	char const* data;
+	size_t size;
+	size_t pos = 0;
+};
+
+//32 bit FNV-1a hash of a buffer, used to detect torn or corrupted records; pass the previous hash to continue it over several buffers
+uint checksum32(void const* data, size_t size, uint previous = 2166136261u);
+
+//Reads a whole file with a single read; returns false if it cannot be opened
+bool readWholeFile(std::string const& filename, std::vector<char>& out);
@@ -0,0 +1,151 @@
+#include "FrameCache.h"
+
+static sf::IntRect getViewportPixels(sf::View const& view, sf::Vector2u size) {
+	//Rounded like sf::RenderTarget::getViewport
+	sf::FloatRect const& viewport = view.getViewport();
+	return sf::IntRect(
+		(int) (0.5f + size.x * viewport.left), (int) (0.5f + size.y * viewport.top),
+		(int) (0.5f + size.x * viewport.width), (int) (0.5f + size.y * viewport.height));
+}
+
+static sf::Vector2f toPixel(sf::Vector2f point, sf::View const& view, sf::IntRect const& viewport) {
+	sf::Vector2f ndc = view.getTransform().transformPoint(point);
+	return sf::Vector2f(viewport.left + (ndc.x + 1) / 2 * viewport.width, viewport.top + (1 - ndc.y) / 2 * viewport.height);
+}
+
+static sf::IntRect unite(sf::IntRect const& a, sf::IntRect const& b) {
+	int left = std::min(a.left, b.left);
+	int top = std::min(a.top, b.top);
+	return sf::IntRect(left, top, std::max(a.left + a.width, b.left + b.width) - left, std::max(a.top + a.height, b.top + b.height) - top);
+}
+
+bool FrameCache::update(Scene const& scene, sf::View const& view, sf::Vector2u windowSize, sf::Color background) {
+	TRACE_ZONE("FrameCache::update");
+	sf::Vector2u frameSize((windowSize.x + scale - 1) / scale, (windowSize.y + scale - 1) / scale);
+	if (frameSize != size) {
+		if (!texture.create(frameSize.x, frameSize.y))
+			return false;
+		texture.setSmooth(false);
+		size = frameSize;
+		valid = false;
+	}
+
+	bool full = !valid || view.getCenter() != viewCenter || view.getSize() != viewSize || view.getRotation() != viewRotation
+		|| view.getViewport() != viewport;
+	changedAreas.clear();
+	if (!full)
+		full = !scene.getChangedAreas(revision, changedAreas);
+
+	//Dirty rectangles in pixels, grown by a pixel for rounding and clipped to the viewport
+	sf::IntRect viewportPixels = getViewportPixels(view, size);
+	dirty.clear();
+	for (size_t i = 0; i < changedAreas.size() && !full; i++) {
+		sf::FloatRect area = scene.getTransform().transformRect(changedAreas[i]);
+		sf::Vector2f corners[4] = {
+			toPixel({ area.left, area.top }, view, viewportPixels), toPixel({ area.left + area.width, area.top }, view, viewportPixels),
+			toPixel({ area.left, area.top + area.height }, view, viewportPixels), toPixel({ area.left + area.width, area.top + area.height }, view, viewportPixels)
+		};
+		float left = corners[0].x, right = left, top = corners[0].y, bottom = top;
+		for (sf::Vector2f const& corner : corners) {
+			left = std::min(left, corner.x);
+			right = std::max(right, corner.x);
+			top = std::min(top, corner.y);
+			bottom = std::max(bottom, corner.y);
+		}
+		int l = (int) std::floor(left) - 1, t = (int) std::floor(top) - 1;
+		sf::IntRect rect(l, t, (int) std::ceil(right) + 1 - l, (int) std::ceil(bottom) + 1 - t);
+		if (!rect.intersects(viewportPixels, rect))
+			continue;
+
+		//Merged with the rectangles it overlaps, so that no pixel is drawn twice
+		for (size_t j = 0; j < dirty.size();) {
+			if (dirty[j].intersects(rect)) {
+				rect = unite(rect, dirty[j]);
+				dirty[j] = dirty.back();
+				dirty.pop_back();
+				j = 0;
+			}
+			else {
+				j++;
+			}
+		}
+		dirty.push_back(rect);
+	}
+
+	ulonglong dirtyPixels = 0;
+	for (sf::IntRect const& rect : dirty)
+		dirtyPixels += (ulonglong) rect.width * rect.height;
+	float frameFraction = (float) dirtyPixels / ((ulonglong) size.x * size.y);
+	if (frameFraction > maxDirtyFraction)
+		full = true;
+
+	if (full) {
+		texture.clear(background);
+		texture.setView(view);
+		texture.draw(scene);
+		statistics.rectangles = 0;
+		statistics.redrawn = 1;
+	}
+	else {
+		for (sf::IntRect const& rect : dirty)
+			redraw(scene, view, rect, background);
+		statistics.rectangles = dirty.size();
+		statistics.redrawn = frameFraction;
+	}
+	if (full || !dirty.empty())
+		texture.display();
+
+	valid = true;
+	revision = scene.getRevision();
+	viewCenter = view.getCenter();
+	viewSize = view.getSize();
+	viewRotation = view.getRotation();
+	viewport = view.getViewport();
+	return true;
+}
+
+void FrameCache::redraw(Scene const& scene, sf::View const& view, sf::IntRect const& rect, sf::Color background) {
+	sf::FloatRect rectViewport((float) rect.left / size.x, (float) rect.top / size.y, (float) rect.width / size.x, (float) rect.height / size.y);
+
+	//The render texture is cleared by the whole, so the rectangle is cleared by drawing over it
+	sf::View pixels{ sf::FloatRect(rect) };
+	pixels.setViewport(rectViewport);
+	texture.setView(pixels);
+	sf::RectangleShape clear(sf::Vector2f((float) rect.width, (float) rect.height));
+	clear.setPosition((float) rect.left, (float) rect.top);
+	clear.setFillColor(background);
+	texture.draw(clear, sf::RenderStates(sf::BlendNone));
+
+	//The part of the view which the rectangle shows
+	sf::IntRect viewportPixels = getViewportPixels(view, size);
+	sf::Vector2f center(rect.left + rect.width / 2.f, rect.top + rect.height / 2.f);
+	sf::Vector2f ndc(2 * (center.x - viewportPixels.left) / viewportPixels.width - 1, 1 - 2 * (center.y - viewportPixels.top) / viewportPixels.height);
+	sf::View clipped(view.getInverseTransform().transformPoint(ndc),
+		sf::Vector2f(view.getSize().x * rect.width / viewportPixels.width, view.getSize().y * rect.height / viewportPixels.height));
+	clipped.setRotation(view.getRotation());
+	clipped.setViewport(rectViewport);
+	texture.setView(clipped);
+	texture.draw(scene);
+}
+
+void FrameCache::setScale(uint frameScale) {
+	scale = std::max(frameScale, 1u);
+}
+
+uint FrameCache::getScale() const {
+	return scale;
+}
+
+void FrameCache::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+	sf::Sprite sprite(texture.getTexture());
+	sprite.setScale((float) scale, (float) scale);
+	target.draw(sprite, states);
+}
+
+void FrameCache::invalidate() {
+	valid = false;
+}
+
+FrameCache::Statistics const& FrameCache::getStatistics() const {
+	return statistics;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "Scene.h"
+
+/* Draws a scene to an offscreen frame, which is then drawn to the window scaled by an integer factor.
+ * With a scale above 1, the frame has fewer pixels than the window and is upscaled with nearest neighbour filtering: pixel art drawn
+ * at its native resolution looks the same, for a fraction of the fragment work.
+ * The frame is kept between updates, so that while the view stays still, only the parts of the frame the scene changed in are
+ * drawn again, and editing costs time in proportion to the edit rather than to the frame.
+ * The area of each tile set since the last frame gives a dirty rectangle in pixels; rectangles overlapping are merged. Each of
+ * them is cleared and the scene drawn again through a view whose viewport is the rectangle only, which clips the drawing like a
+ * scissor would. Chunks are culled by their bounds, so columns of the rows below reaching into a rectangle are drawn again with
+ * it, in render order.
+ * The whole frame is drawn again when the view or the size of the frame changed, when the scene was loaded or cleared, or when the
+ * dirty rectangles cover most of the frame.
+ */
+class FrameCache : public sf::Drawable {
+public:
+	//Brings the cached frame up to date for a window of the given size; returns false if the render texture could not be created
+	bool update(Scene const& scene, sf::View const& view, sf::Vector2u windowSize, sf::Color background);
+
+	//Window pixels per pixel of the frame
+	void setScale(uint scale);
+	uint getScale() const;
+
+	//Draws the whole frame again on the next update
+	void invalidate();
+
+	struct Statistics {
+		//Rectangles drawn again by the last update, 0 if it drew the whole frame
+		size_t rectangles = 0;
+		//Fraction of the frame drawn again by the last update
+		float redrawn = 0;
+	};
+	Statistics const& getStatistics() const;
+
+	//Past this fraction of the frame, dirty rectangles are not worth it
+	static constexpr float maxDirtyFraction = 0.5f;
+
+private:
+	void redraw(Scene const& scene, sf::View const& view, sf::IntRect const& rect, sf::Color background);
+
+	//Draws the frame upscaled, from the top left corner of the target
+	virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+
+	sf::RenderTexture texture;
+	uint scale = 1;
+	//Size of the frame
+	sf::Vector2u size;
+	bool valid = false;
+	Statistics statistics;
+
+	//What the cached frame shows
+	ulonglong revision = 0;
+	sf::Vector2f viewCenter;
+	sf::Vector2f viewSize;
+	float viewRotation = 0;
+	sf::FloatRect viewport;
+
+	//Kept between updates so that they do not allocate
+	std::vector<sf::FloatRect> changedAreas;
+	std::vector<sf::IntRect> dirty;
+};
@@ -0,0 +1,142 @@
+#include <cmath>
+#include <thread>
+#include "FramePacer.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+//Below the lower bound, a sleep overshooting a bit more than usual misses the deadline; above the upper one, spinning wastes the CPU
+static const std::chrono::microseconds minSpinMargin(200);
+static const std::chrono::microseconds maxSpinMargin(3000);
+
+FramePacer::FramePacer() : spinMargin(std::chrono::milliseconds(1)) {
+#ifdef _WIN32
+	//With the default timer resolution of 15.6 ms, sleeps are too coarse to cover most of a frame
+	timeBeginPeriod(1);
+#endif
+}
+
+FramePacer::~FramePacer() {
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::setTargetRate(double hz) {
+	target = hz > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / hz)) : Clock::duration::zero();
+	paced = false;
+	//Adaptive vsync starts again from off, which is also where it stays without a target
+	vsync = false;
+	lateFrames = 0;
+	fastFrames = 0;
+	errors.clear();
+	intervals.clear();
+	next = 0;
+}
+
+double FramePacer::getTargetRate() const {
+	return target > Clock::duration::zero() ? 1 / std::chrono::duration<double>(target).count() : 0;
+}
+
+bool FramePacer::isVsyncWanted() const {
+	return adaptiveVsync && vsync;
+}
+
+void FramePacer::wait() {
+	Clock::time_point now = Clock::now();
+	if (target == Clock::duration::zero()) {
+		paced = false;
+		return;
+	}
+	//First frame, or late by more than a frame (which includes frames skipped by the redraw scheduler): deadlines start again from now
+	if (!paced || now > deadline + target) {
+		paced = true;
+		deadline = now + target;
+		lastWake = now;
+		return;
+	}
+
+	//Vsync is judged on the time the frame took, from the end of the previous wait
+	if (adaptiveVsync) {
+		Clock::duration work = now - lastWake;
+		if (vsync) {
+			lateFrames = work > target ? lateFrames + 1 : 0;
+			if (lateFrames >= 3) {
+				vsync = false;
+				lateFrames = 0;
+			}
+		}
+		else {
+			fastFrames = work < target * 4 / 5 ? fastFrames + 1 : 0;
+			if (fastFrames >= 60) {
+				vsync = true;
+				fastFrames = 0;
+			}
+		}
+	}
+	else {
+		vsync = false;
+	}
+
+	//Presenting the frame waits for the refresh
+	if (vsync) {
+		record(now, now - (lastWake + target));
+		deadline = now + target;
+		return;
+	}
+
+	Clock::time_point sleepEnd = deadline - spinMargin;
+	if (now < sleepEnd) {
+		std::this_thread::sleep_until(sleepEnd);
+		//The margin follows new overshoots at once and decays slowly
+		Clock::duration overshoot = Clock::now() - sleepEnd + std::chrono::microseconds(100);
+		spinMargin = std::clamp<Clock::duration>(std::max(overshoot, spinMargin - spinMargin / 64), minSpinMargin, maxSpinMargin);
+	}
+	while (Clock::now() < deadline)
+		std::this_thread::yield();
+
+	Clock::time_point wake = Clock::now();
+	record(wake, wake - deadline);
+	deadline += target;
+}
+
+void FramePacer::record(Clock::time_point wake, Clock::duration error) {
+	double errorUs = std::abs(std::chrono::duration<double, std::micro>(error).count());
+	double intervalUs = std::chrono::duration<double, std::micro>(wake - lastWake).count();
+	lastWake = wake;
+
+	if (errors.size() < historySize) {
+		errors.push_back(errorUs);
+		intervals.push_back(intervalUs);
+	}
+	else {
+		errors[next] = errorUs;
+		intervals[next] = intervalUs;
+	}
+	next = (next + 1) % historySize;
+}
+
+FramePacer::Statistics FramePacer::getStatistics() const {
+	Statistics stats;
+	stats.spinMargin = std::chrono::duration<double, std::micro>(spinMargin).count();
+	stats.frames = errors.size();
+	if (errors.empty())
+		return stats;
+
+	std::vector<double> sorted = errors;
+	std::sort(sorted.begin(), sorted.end());
+	stats.errorMedian = sorted[sorted.size() / 2];
+	stats.error99 = sorted[sorted.size() * 99 / 100];
+	stats.errorMax = sorted.back();
+
+	double mean = std::accumulate(intervals.begin(), intervals.end(), 0.0) / intervals.size();
+	double variance = 0;
+	for (double interval : intervals)
+		variance += (interval - mean) * (interval - mean);
+	stats.intervalDeviation = std::sqrt(variance / intervals.size());
+	return stats;
+}
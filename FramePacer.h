@@ -0,0 +1,64 @@
+#pragma once
+
+/* Paces the main loop to a target frame rate, more precisely than sf::Window::setFramerateLimit.
+ * Waiting sleeps until shortly before the deadline of the frame, then spins for the rest: OS sleeps overshoot, so the margin left
+ * for spinning follows the largest overshoot recently measured. Deadlines follow each other at the target frame time; a frame
+ * late by more than a whole frame moves them instead of being followed by a burst of frames to catch up.
+ * With adaptive vsync, the target rate is the refresh rate of the display: vsync paces frames while they keep up with it, and is
+ * turned off while they are late, so that a slow frame tears instead of waiting for the next refresh.
+ */
+class FramePacer {
+public:
+	FramePacer();
+	~FramePacer();
+
+	FramePacer(FramePacer const&) = delete;
+	FramePacer& operator=(FramePacer const&) = delete;
+
+	//0 for no limit
+	void setTargetRate(double hz);
+	double getTargetRate() const;
+
+	//Waits for the deadline of the next frame; called just before presenting it
+	void wait();
+
+	bool adaptiveVsync = false;
+	//Whether vsync should be enabled for the frame about to be presented
+	bool isVsyncWanted() const;
+
+	//Times in microseconds, over the last frames
+	struct Statistics {
+		size_t frames = 0;
+		//Lateness of the end of the waits relative to the deadlines
+		double errorMedian = 0;
+		double error99 = 0;
+		double errorMax = 0;
+		//Standard deviation of the intervals between frames
+		double intervalDeviation = 0;
+		double spinMargin = 0;
+	};
+	Statistics getStatistics() const;
+
+	static const size_t historySize = 1024;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void record(Clock::time_point wake, Clock::duration error);
+
+	Clock::duration target{ 0 };
+	Clock::time_point deadline;
+	Clock::time_point lastWake;
+	bool paced = false;
+
+	//Time left to spin before a deadline, following the overshoot of the sleeps
+	Clock::duration spinMargin;
+
+	bool vsync = false;
+	uint lateFrames = 0;
+	uint fastFrames = 0;
+
+	std::vector<double> errors;
+	std::vector<double> intervals;
+	size_t next = 0;
+};
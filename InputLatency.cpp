@@ -0,0 +1,37 @@
+#include "InputLatency.h"
+
+void InputLatency::addInput(Clock::time_point received) {
+	pending.push_back(received);
+}
+
+void InputLatency::presented() {
+	Clock::time_point now = Clock::now();
+	for (Clock::time_point received : pending) {
+		double latency = std::chrono::duration<double, std::milli>(now - received).count();
+		if (latencies.size() < historySize)
+			latencies.push_back(latency);
+		else
+			latencies[next] = latency;
+		next = (next + 1) % historySize;
+	}
+	pending.clear();
+}
+
+void InputLatency::discard() {
+	pending.clear();
+}
+
+InputLatency::Statistics InputLatency::getStatistics() const {
+	Statistics stats;
+	stats.inputs = latencies.size();
+	if (latencies.empty())
+		return stats;
+
+	std::vector<double> sorted = latencies;
+	std::sort(sorted.begin(), sorted.end());
+	stats.median = sorted[sorted.size() / 2];
+	stats.p95 = sorted[sorted.size() * 95 / 100];
+	stats.p99 = sorted[sorted.size() * 99 / 100];
+	stats.max = sorted.back();
+	return stats;
+}
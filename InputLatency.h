@@ -0,0 +1,34 @@
+#pragma once
+
+/* Measures the time from inputs to the presentation of the frame showing their effect.
+ * SFML events carry no timestamp, so inputs are timestamped when the main loop receives them; frames are timestamped when
+ * display() returns, which waits for the swap with vsync. The latest latencies are kept for percentiles.
+ */
+class InputLatency {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	//Adds an input received at the given time, whose effect is part of the frame being prepared
+	void addInput(Clock::time_point received);
+	//Called once the frame is presented: records the latencies of its inputs
+	void presented();
+	//Drops the inputs of a frame which is not drawn, as nothing they did shows
+	void discard();
+
+	//Latencies in milliseconds, over the latest inputs
+	struct Statistics {
+		size_t inputs = 0;
+		double median = 0;
+		double p95 = 0;
+		double p99 = 0;
+		double max = 0;
+	};
+	Statistics getStatistics() const;
+
+	static const size_t historySize = 256;
+
+private:
+	std::vector<Clock::time_point> pending;
+	std::vector<double> latencies;
+	size_t next = 0;
+};
@@ -1,14 +1,55 @@
 #include <chrono>
 #include "SceneEditor.h"
+#include "SceneJournal.h"
+#include "Session.h"
+#include "Overlay.h"
+#include "RedrawScheduler.h"
+#include "FramePacer.h"
+#include "InputLatency.h"
+#include "FrameCache.h"
+#include "Overdraw.h"
+#include "Benchmark.h"
+#include "Resources.h"
+#include "AtlasBaker.h"
+
+int main(int argc, char** argv) {
+	std::vector<std::string> args(argv + 1, argv + argc);
+	if (!args.empty() && args[0] == "--bench") {
+		return runBenchmarks(args);
+	}
+	if (!args.empty() && args[0] == "--pack") {
+		return runPackTool(args);
+	}
+	if (!args.empty() && args[0] == "--bake") {
+		return runBakeTool(args);
+	}
+	if (!args.empty() && args[0] == "--replay") {
+		return runReplayTool(args);
+	}
+
+	TRACE_THREAD_NAME("main");
+
+	//Packed resources are used when present; otherwise, or if the archive is damaged, everything is read from the resources directory
+	if (std::filesystem::exists("resources.pak")) {
+		try {
+			if (!Resources::mountArchive("resources.pak"))
+				std::cerr << "Could not open resources.pak; reading the resources directory instead" << std::endl;
+		}
+		catch (GameError const& e) {
+			std::cerr << e.what() << "; reading the resources directory instead" << std::endl;
+		}
+	}
 
-int main() {
 	const int w_x = 1600;
 	const int w_y = 900;
 
+	//Decoding and parsing happen in the background while the window is being created
+	TileSet::Request grasslands = TileSet::getAsync("grasslands");
+
 	sf::RenderWindow window(sf::VideoMode(w_x, w_y), "Main window");
-	//window.setFramerateLimit(60);
+	//The frame rate is capped by the frame pacer (F6) instead of setFramerateLimit, which jitters
 
-	TileSet const& set = TileSet::get("grasslands");
+	TileSet const& set = grasslands.get();
 	Scene s(set);
 
 	const int zoom = 4;
@@ -28,79 +69,284 @@ int main() {
 	tool.foot = "grass foot";
 	tool.lowestHeight = -2 * n_y;
 
+	//SFML reads fonts lazily, so their data must stay alive as long as the font
+	ResourceData fontData;
 	sf::Font font;
-	font.loadFromFile("resources/OpenSans.ttf");
-	sf::Text FPSCounter;
-	FPSCounter.setFont(font);
-	FPSCounter.setFillColor(sf::Color::White);
-	FPSCounter.setOutlineColor(sf::Color::Black);
-	FPSCounter.setOutlineThickness(2);
-	FPSCounter.setPosition(10, 0);
-
-
-	srand(6);
-
-	const int b_x = 3;
-	const int b_y = 2;
-	for (int x = b_x; x < n_x - b_x; x++) {
-		for (int y = b_y; y < n_y - b_y; y++) {
-			tool.use(x, y, height);
+	if (Resources::load("OpenSans.ttf", fontData))
+		font.loadFromMemory(fontData.data, fontData.size);
+	ProfilerOverlay overlay(font);
+
+
+	//Edits are logged to world.scene.log and folded into world.scene in the background
+	const std::string worldFile = "world.scene";
+	bool newWorld = !std::filesystem::exists(worldFile) && !std::filesystem::exists(worldFile + ".log");
+	SceneJournal journal(s, worldFile);
+
+	if (newWorld) {
+		srand(6);
+
+		const int b_x = 3;
+		const int b_y = 2;
+		for (int x = b_x; x < n_x - b_x; x++) {
+			for (int y = b_y; y < n_y - b_y; y++) {
+				tool.use(x, y, height);
+			}
 		}
-	}
 
-	for (int x = 2; x < n_x; x+=3) {
-		for (int y = 2; y < n_y; y+=3) {
-			tool.use(x, y, height + 1 + rand() % 4);
+		for (int x = 2; x < n_x; x+=3) {
+			for (int y = 2; y < n_y; y+=3) {
+				tool.use(x, y, height + 1 + rand() % 4);
+			}
 		}
+		journal.compact();
 	}
 
-	auto start = std::chrono::steady_clock::now();
-	uint frames = 0;
+	//The edits of the last session can be replayed with --replay session.rec, those of the one before with --replay session.rec.old
+	SessionRecorder recorder(s, tool, "session.rec");
+
+	auto lastAutosave = std::chrono::steady_clock::now();
+	//Frames are only drawn when something changed (F4 switches to drawing every frame)
+	RedrawScheduler redraw;
+	//F6 cycles through the frame rate limits, F7 switches adaptive vsync
+	const double frameRates[] = { 0, 60, 120, 144 };
+	size_t frameRate = 0;
+	FramePacer pacer;
+	overlay.pacer = &pacer;
+	bool vsync = false;
+
+	//Right dragging pans the camera; the tile the tool would edit is highlighted under the mouse
+	sf::Vector2i pointer;
+	bool panning = false;
+	sf::Vector2i panStartPointer;
+	sf::View panStartView;
+	sf::RectangleShape cursor(sf::Vector2f(1, 1));
+	cursor.setFillColor(sf::Color::Transparent);
+	cursor.setOutlineColor(sf::Color::White);
+	cursor.setOutlineThickness(0.05f);
+
+	//With late latching (F8), the mouse is sampled just before drawing instead of taken from the last event.
+	//In both modes, the latency of a move is measured from the first mouse event received since the last frame, when the pointer
+	//moved the cursor or the view.
+	InputLatency latency;
+	overlay.latency = &latency;
+	bool lateLatch = false;
+	std::optional<InputLatency::Clock::time_point> pointerMoved;
+
+	//With partial redraws (F9), the scene is drawn to an offscreen frame in which only the tiles changed are drawn again
+	//while the view stays still, and the window shows that frame.
+	//At low resolution (F10), that frame has one pixel per pixel of the tiles and is upscaled to the window; the cursor and the
+	//overlay are still drawn at the resolution of the window.
+	const sf::Color background(20, 20, 30);
+	FrameCache frameCache;
+	bool partialRedraw = false;
+	bool lowResolution = false;
+
+	//F11 shows the number of fragments drawn per pixel instead of the scene
+	OverdrawHeatmap overdraw;
+	bool showOverdraw = false;
+	//F1 switches the culling of hidden subtiles
+	overlay.scene = &s;
 
 	while (window.isOpen()) {
-		while (window.pollEvent(haps)) {
-			switch (haps.type) {
-			case sf::Event::Closed:
-				window.close(); break;
-			case sf::Event::KeyPressed: {
-				switch (haps.key.code) {
-				case sf::Keyboard::Up:
-					height++;
+		TRACE_ZONE("frame");
+		AllocationTracker::Scope frameAllocations;
+		{
+			TRACE_ZONE("events");
+			//With nothing new to show, the loop sleeps until an event comes
+			bool hasEvent = redraw.needsRedraw(s, view) ? window.pollEvent(haps) : waitEvent(window, haps, redraw.idleTimeout);
+			for (; hasEvent; hasEvent = window.pollEvent(haps)) {
+				auto received = InputLatency::Clock::now();
+				switch (haps.type) {
+				case sf::Event::Closed:
+					window.close(); break;
+				//The content of the window can be lost
+				case sf::Event::Resized:
+				case sf::Event::GainedFocus:
+					redraw.requestRedraw(); break;
+				case sf::Event::KeyPressed: {
+					switch (haps.key.code) {
+					case sf::Keyboard::Up:
+						height++;
+						break;
+					case sf::Keyboard::Down:
+						height--;
+						break;
+					case sf::Keyboard::F3:
+						overlay.showDetails = !overlay.showDetails;
+						break;
+					case sf::Keyboard::F4:
+						redraw.onDemand = !redraw.onDemand;
+						break;
+					case sf::Keyboard::F6:
+						frameRate = (frameRate + 1) % std::size(frameRates);
+						pacer.setTargetRate(frameRates[frameRate]);
+						break;
+					case sf::Keyboard::F7:
+						pacer.adaptiveVsync = !pacer.adaptiveVsync;
+						break;
+					case sf::Keyboard::F8:
+						lateLatch = !lateLatch;
+						overlay.lateLatch = lateLatch;
+						break;
+					case sf::Keyboard::F9:
+						partialRedraw = !partialRedraw;
+						frameCache.invalidate();
+						overlay.frameCache = partialRedraw ? &frameCache : nullptr;
+						break;
+					case sf::Keyboard::F10:
+						lowResolution = !lowResolution;
+						frameCache.setScale(lowResolution ? zoom : 1);
+						break;
+					case sf::Keyboard::F11:
+						showOverdraw = !showOverdraw;
+						overlay.overdraw = showOverdraw ? &overdraw : nullptr;
+						break;
+					case sf::Keyboard::F5:
+						journal.compact();
+						break;
+					case sf::Keyboard::F1:
+						s.setOcclusionCulling(!s.isOcclusionCulling());
+						break;
+					case sf::Keyboard::F2: {
+						MemoryReport memory = s.getMemoryReport();
+						memory += TileSet::getLoadedMemoryReport();
+						std::cout << memory.toString() << std::flush;
+						break;
+					}
+					case sf::Keyboard::F12:
+						TRACE_EXPORT("trace.json");
+						break;
+					default: break;
+					}
 					break;
-				case sf::Keyboard::Down:
-					height--;
+				}
+				case sf::Event::MouseMoved:
+					pointer = sf::Vector2i(haps.mouseMove.x, haps.mouseMove.y);
+					if (!pointerMoved)
+						pointerMoved = received;
+					break;
+				case sf::Event::MouseButtonPressed: {
+					sf::Vector2i position(haps.mouseButton.x, haps.mouseButton.y);
+					sf::Vector2i coords = sf::Vector2i(window.mapPixelToCoords(position, view));
+					if (haps.mouseButton.button == sf::Mouse::Left) {
+						recorder.recordUse(coords.x, coords.y, height);
+						AllocationTracker::Scope editAllocations;
+						tool.use(coords.x, coords.y, height);
+						overlay.addEdit(editAllocations.get());
+						latency.addInput(received);
+					}
+					else if (haps.mouseButton.button == sf::Mouse::Right) {
+						panning = true;
+						panStartPointer = position;
+						panStartView = view;
+					}
 					break;
-				default: break;
 				}
-				break;
-			}
-			case sf::Event::MouseButtonPressed: {
-				sf::Vector2i coords = sf::Vector2i(window.mapPixelToCoords(sf::Mouse::getPosition(window), view));
-				if (haps.mouseButton.button == sf::Mouse::Left) {
-					tool.use(coords.x, coords.y, height);
+				case sf::Event::MouseButtonReleased:
+					if (haps.mouseButton.button == sf::Mouse::Right)
+						panning = false;
+					break;
+				default: break;
 				}
-				break;
 			}
-			default: break;
+		}
+		{
+			TRACE_ZONE("save");
+			journal.flush();
+			//Autosaving folds the log into the world file from a snapshot of the scene, on a background thread
+			if (std::chrono::steady_clock::now() - lastAutosave > std::chrono::minutes(1)) {
+				if (journal.getChangedChunkCount() > 0)
+					journal.compact();
+				lastAutosave = std::chrono::steady_clock::now();
 			}
 		}
+		if (lateLatch)
+			pointer = sf::Mouse::getPosition(window);
+		bool pointerChanged = false;
+		if (panning) {
+			sf::Vector2f center = panStartView.getCenter() + window.mapPixelToCoords(panStartPointer, panStartView) - window.mapPixelToCoords(pointer, panStartView);
+			pointerChanged = center != view.getCenter();
+			view.setCenter(center);
+		}
+		sf::Vector2i hovered = sf::Vector2i(window.mapPixelToCoords(pointer, view));
+		sf::Vector2f cursorPosition((float) hovered.x, hovered.y - height / 2.f);
+		if (cursorPosition != cursor.getPosition()) {
+			cursor.setPosition(cursorPosition);
+			redraw.requestRedraw();
+			pointerChanged = true;
+		}
+		//Moves within the same tile show nothing new
+		if (pointerMoved && pointerChanged)
+			latency.addInput(*pointerMoved);
+		pointerMoved.reset();
 
-		window.clear(sf::Color(20, 20, 30));
-		window.setView(view);
-		window.draw(s);
-		window.setView(window.getDefaultView());
-		window.draw(FPSCounter);
-		window.display();
-
-		frames++;
-		auto stop = std::chrono::steady_clock::now();
-		int ms_elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
-		if (ms_elapsed > 500) {
-			FPSCounter.setString(std::to_string((int)((float)frames / ms_elapsed * 1000 + 0.5f)));
-			start = stop;
-			frames = 0;
+		if (overlay.refresh())
+			redraw.requestRedraw();
+		if (!redraw.needsRedraw(s, view)) {
+			overlay.addSkippedFrame();
+			latency.discard();
+			continue;
 		}
+		{
+			TRACE_ZONE("render");
+			window.clear(background);
+			recorder.recordView(view);
+			if (showOverdraw && !overdraw.update(s, view, window.getSize())) {
+				std::cerr << "Could not create the overdraw heatmap" << std::endl;
+				showOverdraw = false;
+				overlay.overdraw = nullptr;
+			}
+			bool offscreen = !showOverdraw && (partialRedraw || lowResolution);
+			if (!partialRedraw)
+				frameCache.invalidate();
+			if (offscreen && !frameCache.update(s, view, window.getSize(), background)) {
+				std::cerr << "Could not create the offscreen frame" << std::endl;
+				offscreen = partialRedraw = lowResolution = false;
+				overlay.frameCache = nullptr;
+			}
+			if (showOverdraw) {
+				window.setView(window.getDefaultView());
+				window.draw(overdraw);
+			}
+			else if (offscreen) {
+				window.setView(window.getDefaultView());
+				window.draw(frameCache);
+			}
+			else {
+				window.setView(view);
+				window.draw(s);
+			}
+			window.setView(view);
+			window.draw(cursor);
+			window.setView(window.getDefaultView());
+			window.draw(overlay);
+		}
+		{
+			TRACE_ZONE("pace");
+			pacer.wait();
+			if (pacer.isVsyncWanted() != vsync) {
+				vsync = !vsync;
+				window.setVerticalSyncEnabled(vsync);
+			}
+		}
+		{
+			TRACE_ZONE("display");
+			window.display();
+		}
+		latency.presented();
+		redraw.presented(s, view);
+		recorder.recordFrame();
+		overlay.addFrame(frameAllocations.get());
 	}
 
+	TRACE_EXPORT("trace.json");
+	//Background compactions and saves read tiles of the scene, which point into the tileset: they end before it is unloaded
+	journal.waitForCompaction();
+	try {
+		s.waitForSave();
+	}
+	catch (std::exception const& e) {
+		std::cerr << e.what() << std::endl;
+	}
 	TileSet::unload_all();
 }
\ No newline at end of file
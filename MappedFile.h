@@ -0,0 +1,29 @@
+#pragma once
+
+//Read-only memory mapping of a whole file
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	bool open(std::string const& filename);
+	void close();
+
+	bool isOpen() const;
+	char const* data() const;
+	size_t size() const;
+
+private:
+	char const* ptr = nullptr;
+	size_t length = 0;
+
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
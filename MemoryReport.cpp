@@ -0,0 +1,60 @@
+#include "MemoryReport.h"
+
+size_t MemoryReport::getTotal() const {
+	return std::accumulate(bytes.begin(), bytes.end(), (size_t) 0);
+}
+
+void MemoryReport::addChunk(size_t chunkBytes) {
+	size_t bucket = 0;
+	while (bucket < 63 && (chunkBytes >> (bucket + 1)) != 0)
+		bucket++;
+	if (chunkHistogram.size() <= bucket)
+		chunkHistogram.resize(bucket + 1);
+	chunkHistogram[bucket]++;
+	chunkCount++;
+}
+
+MemoryReport& MemoryReport::operator+=(MemoryReport const& other) {
+	for (int i = 0; i < n_categories; i++)
+		bytes[i] += other.bytes[i];
+	chunkCount += other.chunkCount;
+	packedChunkCount += other.packedChunkCount;
+	packedSourceBytes += other.packedSourceBytes;
+	if (chunkHistogram.size() < other.chunkHistogram.size())
+		chunkHistogram.resize(other.chunkHistogram.size());
+	for (size_t i = 0; i < other.chunkHistogram.size(); i++)
+		chunkHistogram[i] += other.chunkHistogram[i];
+	return *this;
+}
+
+char const* MemoryReport::getCategoryName(Category category) {
+	switch (category) {
+	case chunkContainers: return "chunk containers";
+	case tileStorage: return "tile storage";
+	case subTileVectors: return "subtile vectors";
+	case packedChunks: return "packed chunks";
+	case vertexMeshes: return "vertex meshes";
+	case textureImages: return "texture images";
+	case textures: return "textures";
+	case tileSetMetadata: return "tileset metadata";
+	default: return "unknown";
+	}
+}
+
+std::string MemoryReport::toString() const {
+	std::ostringstream oss;
+	for (int i = 0; i < n_categories; i++)
+		oss << getCategoryName((Category) i) << ": " << bytes[i] << " bytes\n";
+	oss << "total: " << getTotal() << " bytes\n";
+	oss << "chunks: " << chunkCount << " (" << packedChunkCount << " packed, " << packedSourceBytes << " bytes before packing)\n";
+	for (size_t i = 0; i < chunkHistogram.size(); i++) {
+		if (chunkHistogram[i] > 0)
+			oss << "chunks of " << ((size_t) 1 << i) << " to " << ((size_t) 2 << i) - 1 << " bytes: " << chunkHistogram[i] << '\n';
+	}
+	return oss.str();
+}
+
+size_t MemoryReport::stringHeapBytes(std::string const& s) {
+	//Short strings are stored inline
+	return s.capacity() >= sizeof(std::string) ? s.capacity() + 1 : 0;
+}
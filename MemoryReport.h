@@ -0,0 +1,40 @@
+#pragma once
+
+//Memory used by game data, by category. Sizes are estimated from object sizes and container capacities;
+//allocator overhead is not counted, std::map nodes and shared_ptr control blocks are.
+struct MemoryReport {
+	enum Category : uchar {
+		chunkContainers,	//Chunk maps, rows and chunk objects
+		tileStorage,		//Tile lists of unpacked chunks
+		subTileVectors,		//Subtile pointers of the tiles
+		packedChunks,		//Encoded tiles of packed chunks
+		vertexMeshes,		//Chunk meshes; SFML draws them straight from client memory, there are no GPU vertex buffers
+		textureImages,		//Decoded tileset images waiting to be uploaded
+		textures,			//Tileset textures in video memory
+		tileSetMetadata,	//Tile and subtile tables and name index of tilesets
+		n_categories
+	};
+
+	std::array<size_t, n_categories> bytes {};
+
+	size_t chunkCount = 0;
+	size_t packedChunkCount = 0;
+	size_t packedSourceBytes = 0;	//Memory the packed chunks used before being packed
+
+	//chunkHistogram[i] counts the chunks using from 2^i to 2^(i+1) - 1 bytes
+	std::vector<size_t> chunkHistogram;
+
+	size_t getTotal() const;
+	void addChunk(size_t chunkBytes);
+	MemoryReport& operator+=(MemoryReport const& other);
+
+	static char const* getCategoryName(Category category);
+
+	//One line per category, then the totals and the non-empty histogram buckets
+	std::string toString() const;
+
+	//Estimates for the heap parts of standard containers
+	static const size_t mapNodeOverhead = 4 * sizeof(void*);
+	static const size_t sharedPtrControlBlock = 2 * sizeof(void*);
+	static size_t stringHeapBytes(std::string const& s);
+};
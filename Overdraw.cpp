@@ -0,0 +1,71 @@
+#include "Overdraw.h"
+
+static const sf::Color heatColors[OverdrawHeatmap::heatColorCount] = {
+	sf::Color::Black,
+	sf::Color(0, 0, 160),
+	sf::Color(0, 160, 0),
+	sf::Color(220, 220, 0),
+	sf::Color(255, 128, 0),
+	sf::Color(255, 0, 0),
+	sf::Color(255, 0, 0),
+	sf::Color(255, 0, 0),
+	sf::Color::White
+};
+
+bool OverdrawHeatmap::update(Scene const& scene, sf::View const& view, sf::Vector2u size) {
+	TRACE_ZONE("OverdrawHeatmap::update");
+	if (counts.getSize() != size) {
+		if (!counts.create(size.x, size.y) || !heatmap.create(size.x, size.y))
+			return false;
+		heatPixels.resize((size_t) size.x * size.y * 4);
+	}
+	if (unit.getSize().x == 0) {
+		sf::Image one;
+		one.create(1, 1, sf::Color(1, 1, 1));
+		if (!unit.loadFromImage(one))
+			return false;
+		//Covers the texture coordinates of the tileset
+		unit.setRepeated(true);
+	}
+
+	counts.clear(sf::Color::Black);
+	counts.setView(view);
+	sf::RenderStates states(sf::BlendAdd);
+	states.texture = &unit;
+	scene.drawChunks(counts, states);
+	counts.display();
+
+	readback = counts.getTexture().copyToImage();
+	sf::Uint8 const* pixels = readback.getPixelsPtr();
+	size_t n_pixels = (size_t) size.x * size.y;
+	ulonglong fragments = 0;
+	size_t covered = 0;
+	uint max = 0;
+	for (size_t i = 0; i < n_pixels; i++) {
+		uint count = pixels[i * 4];
+		fragments += count;
+		covered += count > 0;
+		max = std::max(max, count);
+
+		sf::Color color = heatColors[std::min(count, heatColorCount - 1)];
+		heatPixels[i * 4] = color.r;
+		heatPixels[i * 4 + 1] = color.g;
+		heatPixels[i * 4 + 2] = color.b;
+		heatPixels[i * 4 + 3] = 255;
+	}
+	heatmap.update(heatPixels.data());
+
+	statistics.perPixel = n_pixels > 0 ? (double) fragments / n_pixels : 0;
+	statistics.perCoveredPixel = covered > 0 ? (double) fragments / covered : 0;
+	statistics.max = max;
+	statistics.coverage = n_pixels > 0 ? (double) covered / n_pixels : 0;
+	return true;
+}
+
+OverdrawHeatmap::Statistics const& OverdrawHeatmap::getStatistics() const {
+	return statistics;
+}
+
+void OverdrawHeatmap::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+	target.draw(sf::Sprite(heatmap), states);
+}
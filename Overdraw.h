@@ -0,0 +1,40 @@
+#pragma once
+#include "Scene.h"
+
+/* Debug view of the overdraw of a scene: how many fragments each pixel of the frame gets, whatever they end up looking like.
+ * The chunks are drawn with a 1x1 texture of value 1 and additive blending, so that every quad adds one to the pixels it covers,
+ * transparent texels included, as they cost as much to rasterize. The counts are read back to the CPU for the statistics and
+ * turned into a heatmap: dark blue for 1 fragment, then green, yellow, orange, red from 5 and white from 8.
+ * Counts saturate at 255, and reading them back stalls the pipeline: it is a debugging aid, not to be left on while profiling the rest.
+ */
+class OverdrawHeatmap : public sf::Drawable {
+public:
+	//Draws the scene through the view to count the fragments; returns false if the render texture could not be created
+	bool update(Scene const& scene, sf::View const& view, sf::Vector2u size);
+
+	struct Statistics {
+		//Fragments per pixel of the frame, and per pixel covered by at least one fragment
+		double perPixel = 0;
+		double perCoveredPixel = 0;
+		uint max = 0;
+		//Fraction of the frame covered
+		double coverage = 0;
+	};
+	//Of the last update
+	Statistics const& getStatistics() const;
+
+	static const uint heatColorCount = 9;
+
+private:
+	//Draws the heatmap from the top left corner of the target
+	virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+
+	sf::RenderTexture counts;
+	sf::Texture unit;
+	sf::Texture heatmap;
+	//Kept between updates so that they do not allocate
+	sf::Image readback;
+	std::vector<sf::Uint8> heatPixels;
+
+	Statistics statistics;
+};
@@ -0,0 +1,108 @@
+#include "Overlay.h"
+
+ProfilerOverlay::ProfilerOverlay(sf::Font const& font) :
+	intervalStart(std::chrono::steady_clock::now()), lastFrame(intervalStart)
+{
+	text.setFont(font);
+	text.setFillColor(sf::Color::White);
+	text.setOutlineColor(sf::Color::Black);
+	text.setOutlineThickness(2);
+	text.setPosition(10, 0);
+}
+
+void ProfilerOverlay::addFrame(AllocationTracker::Counts const& allocations) {
+	auto now = std::chrono::steady_clock::now();
+	frames++;
+	maxFrameMs = std::max(maxFrameMs, std::chrono::duration<double, std::milli>(now - lastFrame).count());
+	lastFrame = now;
+
+	frameAllocations += allocations;
+	maxFrameAllocations = std::max(maxFrameAllocations, allocations.allocations);
+	if (AllocationTracker::frameBudget > 0 && allocations.allocations > AllocationTracker::frameBudget)
+		overBudgetFrames++;
+}
+
+void ProfilerOverlay::addSkippedFrame() {
+	skippedFrames++;
+}
+
+void ProfilerOverlay::addEdit(AllocationTracker::Counts const& allocations) {
+	edits++;
+	editAllocations += allocations;
+}
+
+bool ProfilerOverlay::refresh() {
+	auto now = std::chrono::steady_clock::now();
+	double elapsedMs = std::chrono::duration<double, std::milli>(now - intervalStart).count();
+	if (elapsedMs <= updateIntervalMs)
+		return false;
+
+	std::string updated = format(elapsedMs);
+	intervalStart = now;
+	frames = 0;
+	maxFrameMs = 0;
+	frameAllocations = {};
+	maxFrameAllocations = 0;
+	overBudgetFrames = 0;
+	edits = 0;
+	editAllocations = {};
+
+	if (updated == shown)
+		return false;
+	shown = updated;
+	text.setString(shown);
+	return true;
+}
+
+std::string ProfilerOverlay::format(double elapsedMs) const {
+	std::ostringstream oss;
+	oss << (int) (frames / elapsedMs * 1000 + 0.5);
+	if (showDetails) {
+		oss.precision(3);
+		oss << " fps\n";
+		if (frames > 0) {
+			oss << "frame: " << elapsedMs / frames << " ms, max " << maxFrameMs << " ms\n";
+			if (AllocationTracker::enabled)
+				oss << "allocations/frame: " << (double) frameAllocations.allocations / frames
+					<< " (" << frameAllocations.bytes / frames << " B), max " << maxFrameAllocations << '\n';
+			else
+				oss << "allocations: not tracked\n";
+		}
+		if (pacer && pacer->getTargetRate() > 0) {
+			FramePacer::Statistics pacing = pacer->getStatistics();
+			oss << "pacing " << pacer->getTargetRate() << " Hz" << (pacer->isVsyncWanted() ? " (vsync)" : "")
+				<< ": error " << pacing.errorMedian << "/" << pacing.error99 << "/" << pacing.errorMax << " us (median/99%/max)"
+				<< ", interval deviation " << pacing.intervalDeviation << " us\n";
+		}
+		if (latency && latency->getStatistics().inputs > 0) {
+			InputLatency::Statistics input = latency->getStatistics();
+			oss << "input latency" << (lateLatch ? " (late latch)" : "") << ": " << input.median << "/" << input.p95 << "/"
+				<< input.p99 << "/" << input.max << " ms (median/95%/99%/max)\n";
+		}
+		if (scene) {
+			Scene::DrawStatistics const& drawn = scene->getDrawStatistics();
+			oss << "subtiles: " << drawn.subTiles << " drawn, " << drawn.occluded << " occluded"
+				<< (scene->isOcclusionCulling() ? "" : " (culling off)") << '\n';
+		}
+		if (frameCache) {
+			FrameCache::Statistics const& redrawn = frameCache->getStatistics();
+			oss << "partial redraw: " << (redrawn.rectangles > 0 ? std::to_string(redrawn.rectangles) + " rectangles, " : std::string("whole frame, "))
+				<< redrawn.redrawn * 100 << "% of the frame\n";
+		}
+		if (overdraw) {
+			OverdrawHeatmap::Statistics const& fragments = overdraw->getStatistics();
+			oss << "overdraw: " << fragments.perCoveredPixel << " fragments per covered pixel (" << fragments.perPixel << " per pixel, "
+				<< fragments.coverage * 100 << "% covered), max " << fragments.max << '\n';
+		}
+		if (AllocationTracker::frameBudget > 0)
+			oss << "frames over budget (" << AllocationTracker::frameBudget << "): " << overBudgetFrames << '\n';
+		if (AllocationTracker::enabled && edits > 0)
+			oss << "allocations/edit: " << (double) editAllocations.allocations / edits << " (" << editAllocations.bytes / edits << " B)\n";
+		oss << "skipped frames: " << skippedFrames;
+	}
+	return oss.str();
+}
+
+void ProfilerOverlay::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+	target.draw(text, states);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "AllocationTracker.h"
+#include "FramePacer.h"
+#include "InputLatency.h"
+#include "FrameCache.h"
+#include "Overdraw.h"
+
+/* Statistics drawn over the game, averaged over half a second: the frame rate, and with the details shown, the frame times,
+ * the pacing error of the frame pacer, the input latency, the part of the frame drawn again with partial redraws,
+ * the subtiles drawn and occluded, the overdraw, the allocations made by the main thread per frame and per edit, and the frames skipped
+ * as there was nothing new to show.
+ */
+class ProfilerOverlay : public sf::Drawable {
+public:
+	ProfilerOverlay(sf::Font const& font);
+
+	//Called at the end of every presented frame with the allocations made during the frame
+	void addFrame(AllocationTracker::Counts const& allocations);
+	void addSkippedFrame();
+	void addEdit(AllocationTracker::Counts const& allocations);
+
+	//Updates the text once the statistics interval is over; returns true if it changed
+	bool refresh();
+
+	bool showDetails = false;
+	FramePacer const* pacer = nullptr;
+	InputLatency const* latency = nullptr;
+	bool lateLatch = false;
+	Scene const* scene = nullptr;
+	//Set while partial redraws are on
+	FrameCache const* frameCache = nullptr;
+	//Set while the overdraw heatmap is shown
+	OverdrawHeatmap const* overdraw = nullptr;
+
+	static const int updateIntervalMs = 500;
+
+private:
+	std::string format(double elapsedMs) const;
+
+	virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+
+	sf::Text text;
+	std::string shown;
+
+	std::chrono::steady_clock::time_point intervalStart;
+	std::chrono::steady_clock::time_point lastFrame;
+
+	//Statistics of the current interval
+	uint frames = 0;
+	double maxFrameMs = 0;
+	AllocationTracker::Counts frameAllocations;
+	ulonglong maxFrameAllocations = 0;
+	uint overBudgetFrames = 0;
+	uint edits = 0;
+	AllocationTracker::Counts editAllocations;
+
+	ulonglong skippedFrames = 0;
+};
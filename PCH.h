@@ -1,16 +1,26 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <deque>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <numeric>
+#include <optional>
 
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
@@ -25,6 +35,8 @@ typedef unsigned short ushort;
 typedef unsigned int uint;
 typedef unsigned long ulong;
 typedef unsigned long long ulonglong;
+typedef long long longlong;
 
 #include "Error.h"
-#include "Tools.h"
\ No newline at end of file
+#include "Tools.h"
+#include "Trace.h"
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include <thread>
+#include "RedrawScheduler.h"
+
+bool RedrawScheduler::needsRedraw(Scene const& scene, sf::View const& view) const {
+	return !onDemand || redrawRequested || animations > 0
+		|| scene.getRevision() != sceneRevision
+		|| view.getCenter() != viewCenter || view.getSize() != viewSize
+		|| view.getRotation() != viewRotation || view.getViewport() != viewport;
+}
+
+void RedrawScheduler::presented(Scene const& scene, sf::View const& view) {
+	redrawRequested = false;
+	sceneRevision = scene.getRevision();
+	viewCenter = view.getCenter();
+	viewSize = view.getSize();
+	viewRotation = view.getRotation();
+	viewport = view.getViewport();
+}
+
+void RedrawScheduler::requestRedraw() {
+	redrawRequested = true;
+}
+
+void RedrawScheduler::beginAnimation() {
+	animations++;
+}
+
+void RedrawScheduler::endAnimation() {
+	if (animations > 0)
+		animations--;
+}
+
+bool waitEvent(sf::Window& window, sf::Event& event, std::chrono::milliseconds timeout) {
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (!window.pollEvent(event)) {
+		auto now = std::chrono::steady_clock::now();
+		if (now >= deadline)
+			return false;
+		//Short enough for input not to feel late, long enough for an idle editor to use next to no CPU
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(deadline - now, std::chrono::milliseconds(4)));
+	}
+	return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "Scene.h"
+
+/* Decides whether the main loop has to present a new frame. In on-demand mode a frame is only presented when the scene was
+ * edited or loaded, the view changed, a redraw was requested (overlay and UI changes) or an animation is running;
+ * otherwise the loop waits for events and skips the frame.
+ */
+class RedrawScheduler {
+public:
+	bool needsRedraw(Scene const& scene, sf::View const& view) const;
+	//Called once a frame was presented, with what it showed
+	void presented(Scene const& scene, sf::View const& view);
+
+	void requestRedraw();
+	//Frames are presented continuously while at least one animation is running
+	void beginAnimation();
+	void endAnimation();
+
+	//Presents every frame when false
+	bool onDemand = true;
+	//Longest wait for events without a frame, so that timed work (autosaves, statistics) still runs
+	std::chrono::milliseconds idleTimeout{ 100 };
+
+private:
+	bool redrawRequested = true;
+	uint animations = 0;
+	ulonglong sceneRevision = 0;
+	sf::Vector2f viewCenter;
+	sf::Vector2f viewSize;
+	float viewRotation = 0;
+	sf::FloatRect viewport;
+};
+
+//sf::Window::waitEvent cannot time out: polls for events until one comes or the timeout expires. Returns false on timeout.
+bool waitEvent(sf::Window& window, sf::Event& event, std::chrono::milliseconds timeout);
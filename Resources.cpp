@@ -0,0 +1,186 @@
+#include "Resources.h"
+#include "Binary.h"
+#include "TileSet.h"
+
+/* Archive layout:
+ * header, then one entry per resource (name offset and length in the name table, data offset, size, mtime),
+ * then the name table, then the resource data, each resource aligned to 16 bytes
+ */
+struct ArchiveHeader {
+	char magic[4];
+	uint version;
+	uint n_entries;
+	uint nameTableSize;
+};
+
+struct ArchiveEntryRecord {
+	uint nameOffset;
+	uint nameLength;
+	ulonglong offset;
+	ulonglong size;
+	ulonglong mtime;
+};
+
+static const char archiveMagic[4] = { 'R', 'P', 'G', 'A' };
+static const uint archiveVersion = 1;
+static const size_t archiveAlignment = 16;
+
+const std::string Resources::directory = "resources";
+MappedFile Resources::archive;
+std::map<std::string, Resources::ArchiveEntry> Resources::archiveIndex;
+
+bool Resources::mountArchive(std::string const& filename) {
+	unmountArchive();
+	if (!archive.open(filename))
+		return false;
+
+	try {
+		BinaryReader reader(archive.data(), archive.size());
+		ArchiveHeader header = reader.read<ArchiveHeader>();
+		if (std::memcmp(header.magic, archiveMagic, 4) != 0 || header.version != archiveVersion)
+			throw GameError("Invalid resource archive " + filename);
+
+		if (header.n_entries > reader.remaining() / sizeof(ArchiveEntryRecord))
+			throw GameError("Corrupted resource archive " + filename);
+		std::vector<ArchiveEntryRecord> records(header.n_entries);
+		reader.readArray(records.data(), records.size());
+		char const* names = reader.skip(header.nameTableSize);
+
+		for (ArchiveEntryRecord const& r : records) {
+			if (r.nameOffset + (ulonglong) r.nameLength > header.nameTableSize || r.offset + r.size > archive.size())
+				throw GameError("Corrupted resource archive " + filename);
+			archiveIndex[std::string(names + r.nameOffset, r.nameLength)] = { r.offset, r.size, r.mtime };
+		}
+	}
+	catch (GameError const&) {
+		unmountArchive();
+		throw;
+	}
+	return true;
+}
+
+void Resources::unmountArchive() {
+	archiveIndex.clear();
+	archive.close();
+}
+
+bool Resources::load(std::string const& name, ResourceData& out) {
+	if (loadArchived(name, out))
+		return true;
+
+	auto buffer = std::make_shared<std::vector<char>>();
+	if (!readWholeFile(getPath(name), *buffer))
+		return false;
+	out.data = buffer->data();
+	out.size = buffer->size();
+	out.buffer = std::move(buffer);
+	return true;
+}
+
+bool Resources::loadArchived(std::string const& name, ResourceData& out) {
+	auto it = archiveIndex.find(name);
+	if (it == archiveIndex.end())
+		return false;
+	out.data = archive.data() + it->second.offset;
+	out.size = (size_t) it->second.size;
+	out.buffer.reset();
+	return true;
+}
+
+bool Resources::stat(std::string const& name, ulonglong& size, ulonglong& mtime) {
+	auto it = archiveIndex.find(name);
+	if (it != archiveIndex.end()) {
+		size = it->second.size;
+		mtime = it->second.mtime;
+		return true;
+	}
+
+	namespace fs = std::filesystem;
+	std::error_code ec;
+	std::string path = getPath(name);
+	size = (ulonglong) fs::file_size(path, ec);
+	if (ec)
+		return false;
+	mtime = (ulonglong) fs::last_write_time(path, ec).time_since_epoch().count();
+	return !ec;
+}
+
+std::string Resources::getPath(std::string const& name) {
+	return directory + '/' + name;
+}
+
+std::vector<std::string> Resources::listTileSets() {
+	namespace fs = std::filesystem;
+	std::vector<std::string> names;
+	for (auto const& entry : fs::recursive_directory_iterator(directory)) {
+		fs::path path = entry.path();
+		if (path.extension() == ".json" && fs::exists(fs::path(path).replace_extension(".png")))
+			names.push_back(fs::relative(path, directory).replace_extension().generic_string());
+	}
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+void Resources::pack(std::string const& archiveFile) {
+	namespace fs = std::filesystem;
+
+	std::vector<std::string> names;
+	for (auto const& entry : fs::recursive_directory_iterator(directory)) {
+		std::error_code ec;
+		if (entry.is_regular_file() && !fs::equivalent(entry.path(), archiveFile, ec))
+			names.push_back(fs::relative(entry.path(), directory).generic_string());
+	}
+	std::sort(names.begin(), names.end());
+
+	BinaryWriter nameTable;
+	std::vector<ArchiveEntryRecord> records(names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		records[i].nameOffset = (uint) nameTable.size();
+		records[i].nameLength = (uint) names[i].size();
+		nameTable.append(names[i].data(), names[i].size());
+	}
+
+	ArchiveHeader header {};
+	std::memcpy(header.magic, archiveMagic, 4);
+	header.version = archiveVersion;
+	header.n_entries = (uint) names.size();
+	header.nameTableSize = (uint) nameTable.size();
+
+	BinaryWriter data;
+	size_t dataStart = sizeof(ArchiveHeader) + sizeof(ArchiveEntryRecord) * records.size() + nameTable.size();
+	for (size_t i = 0; i < names.size(); i++) {
+		size_t padding = (archiveAlignment - (dataStart + data.size()) % archiveAlignment) % archiveAlignment;
+		data.append(std::string(padding, '\0').data(), padding);
+
+		std::vector<char> bytes;
+		if (!readWholeFile(getPath(names[i]), bytes))
+			throw GameError("Could not read resource " + names[i] + " while packing");
+		records[i].offset = dataStart + data.size();
+		records[i].size = bytes.size();
+		ulonglong size;
+		stat(names[i], size, records[i].mtime);
+		data.append(bytes.data(), bytes.size());
+	}
+
+	BinaryWriter writer;
+	writer.write(header);
+	writer.writeArray(records.data(), records.size());
+	writer.append(nameTable.getBuffer().data(), nameTable.size());
+	writer.append(data.getBuffer().data(), data.size());
+	if (!writer.saveToFile(archiveFile))
+		throw GameError("Could not write resource archive " + archiveFile);
+}
+
+int runPackTool(std::vector<std::string> const& args) {
+	std::string archiveFile = args.size() > 1 ? args[1] : "resources.pak";
+
+	//Loading every tileset writes its binary cache into the resources directory, where pack() picks it up
+	for (auto const& name : Resources::listTileSets()) {
+		TileSet::get(name);
+	}
+	TileSet::unload_all();
+
+	Resources::pack(archiveFile);
+	std::cout << "Packed " << Resources::directory << " into " << archiveFile << std::endl;
+	return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "MappedFile.h"
+
+//Read-only view of the bytes of a resource
+struct ResourceData {
+	char const* data = nullptr;
+	size_t size = 0;
+
+	//Owns the bytes of resources read from loose files; archived resources point into the archive mapping
+	std::shared_ptr<std::vector<char>> buffer;
+};
+
+/* Access to the files of the resources/ directory, by path relative to it (e.g. "grasslands.png").
+ * When a packed archive is mounted, resources are served from its memory mapping;
+ * resources missing from the archive fall back to loose files.
+ * Mounting is not thread-safe and should happen at startup, before anything is loaded.
+ */
+class Resources {
+public:
+	static bool mountArchive(std::string const& filename);
+	static void unmountArchive();
+
+	//Reads a whole resource: a view into the archive if it is packed, a file read otherwise
+	static bool load(std::string const& name, ResourceData& out);
+
+	//Only succeeds for packed resources
+	static bool loadArchived(std::string const& name, ResourceData& out);
+
+	//Size and modification time of a resource; the time is only meaningful for comparisons
+	static bool stat(std::string const& name, ulonglong& size, ulonglong& mtime);
+
+	//Path of the loose file of a resource
+	static std::string getPath(std::string const& name);
+
+	//Names of the tilesets with both a json and a png file in the resources directory
+	static std::vector<std::string> listTileSets();
+
+	//Packs every file of the resources directory into an archive
+	static void pack(std::string const& archiveFile);
+
+	static const std::string directory;
+
+private:
+	struct ArchiveEntry {
+		ulonglong offset;
+		ulonglong size;
+		ulonglong mtime;
+	};
+
+	static MappedFile archive;
+	static std::map<std::string, ArchiveEntry> archiveIndex;
+};
+
+//Command line packing mode (RPG --pack [archive]); also builds the tileset caches so that they are packed too
+int runPackTool(std::vector<std::string> const& args);
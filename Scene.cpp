@@ -1,23 +1,7 @@
 #include "PCH.h"
 #include "Scene.h"
-
-inline bool Scene::Chunk::TileCoords::RenderOrderComparator::operator()(TileCoords const& before, TileCoords const& after) const {
-	if (before.y < after.y)
-		return true;
-	if (before.y > after.y)
-		return false;
-	if (before.x < after.x)
-		return true;
-	if (before.x > after.x)
-		return false;
-	if (before.z < after.z)
-		return true;
-	if (before.z > after.z)
-		return false;
-	if (before.subz < after.subz)
-		return true;
-	return false;
-}
+#include "SceneFile.h"
+#include "SceneJournal.h"
 
 		/*
 		sf::Vector2f offset = sf::Vector2f((float)coords.x, (float)coords.y + zOffset);
@@ -38,37 +22,32 @@ inline bool Scene::Chunk::TileCoords::RenderOrderComparator::operator()(TileCoor
 		bufferIndex += 6;
 		*/
 
-inline bool Scene::ChunkCoords::Comparator::operator()(ChunkCoords const& before, ChunkCoords const& after) const {
-	if (before.Y < after.Y)
-		return true;
-	if (before.Y > after.Y)
-		return false;
-	if (before.X < after.X)
-		return true;
-	return false;
-}
-
 void Scene::setTile(Tile const& t, int x, int y, int z, int subz) {
-	chunks[ChunkCoords::fromTileCoords(x, y)].tiles[{ x, y, z, subz }] = t;
-
-	//TODO sprites should be loaded into the currentSprites map at chunk loading instead
-	SpriteCoords sc{ (float)x, (float)y, (float)z, subz };
-	currentSprites.erase(sc);
-	for (auto& subtile : t.subTiles) {
-		currentSprites.insert({ sc, {
-			subtile->textureRect,
-			SubTile::subPosRects.at(subtile->subPosition)
-		} });
-	}
+	TRACE_ZONE("Scene::setTile");
+	ChunkCoords coords = ChunkCoords::fromTileCoords(x, y);
+	Chunk& chunk = chunks.modify(coords);
+	touchChunk(coords, chunk);
+	chunk.setTile({ x, y, z, subz }, t);
+	chunk.meshDirty = true;
+	chunk.boundsDirty = true;
+	minHeight = std::min(minHeight, z);
+	maxHeight = std::max(maxHeight, z);
+
+	revision++;
+	std::pair<ulonglong, sf::FloatRect> changed(revision, sf::FloatRect((float) x, y - z / 2.f, 1, 1));
+	if (changedAreas.size() < maxChangedAreas)
+		changedAreas.push_back(changed);
+	else
+		changedAreas[nextChangedArea] = changed;
+	nextChangedArea = (nextChangedArea + 1) % maxChangedAreas;
+	if (journal)
+		journal->record(t, x, y, z, subz);
 }
 
 Tile const* Scene::getTile(int x, int y, int z, int subz) const {
-	auto it_c = chunks.find(ChunkCoords::fromTileCoords(x, y));
-	if (it_c != chunks.end()) {
-		auto it_t = it_c->second.tiles.find({ x, y, z, subz });
-		if (it_t != it_c->second.tiles.end())
-			return &it_t->second;
-	}
+	ChunkCoords coords = ChunkCoords::fromTileCoords(x, y);
+	if (Chunk const* chunk = chunks.find(coords))
+		return touchChunk(coords, *chunk).findTile({ x, y, z, subz });
 	return nullptr;
 }
 
@@ -77,10 +56,11 @@ TileSet const& Scene::getTileSet() const {
 }
 
 int Scene::getLowestTileHeight(int x, int y, int subz, int min_height) const {
-	auto it_c = chunks.find(ChunkCoords::fromTileCoords(x, y));
-	if (it_c != chunks.end()) {
-		auto const& tiles = it_c->second.tiles;
-		for (auto it_t = tiles.lower_bound({ x, y, min_height, subz });
+	ChunkCoords coords = ChunkCoords::fromTileCoords(x, y);
+	if (Chunk const* found = chunks.find(coords)) {
+		auto const& chunk = touchChunk(coords, *found);
+		auto const& tiles = chunk.tiles;
+		for (auto it_t = chunk.lowerBound({ x, y, min_height, subz });
 			it_t != tiles.end() && it_t->first.x == x && it_t->first.y == y;
 			it_t++)
 		{
@@ -92,10 +72,11 @@ int Scene::getLowestTileHeight(int x, int y, int subz, int min_height) const {
 }
 
 int Scene::getHighestTileHeight(int x, int y, int subz, int max_height) const {
-	auto it_c = chunks.find(ChunkCoords::fromTileCoords(x, y));
-	if (it_c != chunks.end()) {
-		auto const& tiles = it_c->second.tiles;
-		for (auto it_t = std::make_reverse_iterator(tiles.upper_bound({ x, y, max_height, subz }));
+	ChunkCoords coords = ChunkCoords::fromTileCoords(x, y);
+	if (Chunk const* found = chunks.find(coords)) {
+		auto const& chunk = touchChunk(coords, *found);
+		auto const& tiles = chunk.tiles;
+		for (auto it_t = std::make_reverse_iterator(chunk.upperBound({ x, y, max_height, subz }));
 			it_t != tiles.rend() && it_t->first.x == x && it_t->first.y == y;
 			it_t++)
 		{
@@ -106,53 +87,455 @@ int Scene::getHighestTileHeight(int x, int y, int subz, int max_height) const {
 	return std::numeric_limits<int>::min();
 }
 
+Scene::Chunk::TileList::const_iterator Scene::Chunk::lowerBound(TileCoords const& coords) const {
+	return std::lower_bound(tiles.begin(), tiles.end(), coords, [](auto const& entry, TileCoords const& c) {
+		return TileCoords::RenderOrderComparator()(entry.first, c);
+	});
+}
+
+Scene::Chunk::TileList::const_iterator Scene::Chunk::upperBound(TileCoords const& coords) const {
+	return std::upper_bound(tiles.begin(), tiles.end(), coords, [](TileCoords const& c, auto const& entry) {
+		return TileCoords::RenderOrderComparator()(c, entry.first);
+	});
+}
+
+Tile const* Scene::Chunk::findTile(TileCoords const& coords) const {
+	auto it = lowerBound(coords);
+	if (it != tiles.end() && !TileCoords::RenderOrderComparator()(coords, it->first))
+		return &it->second;
+	return nullptr;
+}
+
+void Scene::Chunk::setTile(TileCoords const& coords, Tile const& tile) {
+	auto it = tiles.begin() + (lowerBound(coords) - tiles.cbegin());
+	if (it != tiles.end() && !TileCoords::RenderOrderComparator()(coords, it->first))
+		it->second = tile;
+	else
+		tiles.emplace(it, coords, tile);
+}
+
+Scene::Chunk::Chunk(Chunk const& other) :
+	tiles(other.tiles), packed(other.packed), unpackedSize(other.unpackedSize),
+	lastUsed(other.lastUsed), bounds(other.bounds), boundsDirty(other.boundsDirty)
+{}
+
+bool Scene::Chunk::isEmpty() const {
+	return tiles.empty() && packed.empty();
+}
+
+void Scene::Chunk::reportMemory(MemoryReport& report) const {
+	report.bytes[MemoryReport::tileStorage] += tiles.capacity() * sizeof(TileList::value_type);
+	for (auto const& [coords, tile] : tiles)
+		report.bytes[MemoryReport::subTileVectors] += tile.subTiles.capacity() * sizeof(SubTile const*);
+	report.bytes[MemoryReport::packedChunks] += packed.capacity();
+	report.bytes[MemoryReport::vertexMeshes] += mesh.capacity() * sizeof(sf::Vertex);
+}
+
+size_t Scene::Chunk::getMemoryUsage() const {
+	MemoryReport report;
+	reportMemory(report);
+	return report.getTotal();
+}
+
+//Writes the 6 vertices of a subtile quad from its constexpr template
+template<SubTile::SubPosition P>
+static inline void writeQuad(sf::Vertex* v, sf::Vector2f posOffset, sf::Vector2f texturePos, float tileSize) {
+	constexpr SubTileQuad const& quad = subTileQuads[P];
+	for (int i = 0; i < 6; i++) {
+		v[i].position = { posOffset.x + quad.x[i], posOffset.y + quad.y[i] };
+		v[i].texCoords = { texturePos.x + tileSize * quad.u[i], texturePos.y + tileSize * quad.v[i] };
+	}
+}
+
+static inline void writeQuad(SubTile::SubPosition subPos, sf::Vertex* v, sf::Vector2f posOffset, sf::Vector2f texturePos, float tileSize) {
+	switch (subPos) {
+	case SubTile::full: writeQuad<SubTile::full>(v, posOffset, texturePos, tileSize); break;
+	case SubTile::tlCorner: writeQuad<SubTile::tlCorner>(v, posOffset, texturePos, tileSize); break;
+	case SubTile::trCorner: writeQuad<SubTile::trCorner>(v, posOffset, texturePos, tileSize); break;
+	case SubTile::blCorner: writeQuad<SubTile::blCorner>(v, posOffset, texturePos, tileSize); break;
+	case SubTile::brCorner: writeQuad<SubTile::brCorner>(v, posOffset, texturePos, tileSize); break;
+	case SubTile::topHalf: writeQuad<SubTile::topHalf>(v, posOffset, texturePos, tileSize); break;
+	case SubTile::botHalf: writeQuad<SubTile::botHalf>(v, posOffset, texturePos, tileSize); break;
+	case SubTile::leftHalf: writeQuad<SubTile::leftHalf>(v, posOffset, texturePos, tileSize); break;
+	case SubTile::rightHalf: writeQuad<SubTile::rightHalf>(v, posOffset, texturePos, tileSize); break;
+	default: break;
+	}
+}
+
+//Cells of half a tile covered by each subposition: a mask of the two columns of the tile, and the range of its two rows
+struct SubPositionCells {
+	ushort columns;
+	int firstRow, endRow;
+};
+
+constexpr std::array<SubPositionCells, SubTile::n_subPositions> makeSubPositionCells() {
+	std::array<SubPositionCells, SubTile::n_subPositions> cells {};
+	for (size_t p = 0; p < SubTile::n_subPositions; p++) {
+		SubTile::Rect const& r = SubTile::subPosRects[p];
+		int firstColumn = (int) (r.left * 2), endColumn = (int) ((r.left + r.width) * 2);
+		for (int c = firstColumn; c < endColumn; c++)
+			cells[p].columns |= (ushort) (1 << c);
+		cells[p].firstRow = (int) (r.top * 2);
+		cells[p].endRow = (int) ((r.top + r.height) * 2);
+	}
+	return cells;
+}
+
+static constexpr std::array<SubPositionCells, SubTile::n_subPositions> subPositionCells = makeSubPositionCells();
+
+void Scene::Chunk::buildMesh(float tileSize, bool cullOccluded, std::vector<ushort>& coverage) const {
+	size_t n_subTiles = 0;
+	int left = std::numeric_limits<int>::max();
+	int firstRow = std::numeric_limits<int>::max(), lastRow = std::numeric_limits<int>::min();
+	for (auto const& [coords, tile] : tiles) {
+		n_subTiles += tile.subTiles.size();
+		left = std::min(left, coords.x);
+		firstRow = std::min(firstRow, 2 * coords.y - coords.z);
+		lastRow = std::max(lastRow, 2 * coords.y - coords.z);
+	}
+	//One bit per column of half tiles, the chunk being 16 of them wide, for each row of half tiles on the screen
+	cullOccluded = cullOccluded && !tiles.empty() && (longlong) lastRow - firstRow < maxOcclusionRows;
+	if (cullOccluded)
+		coverage.assign(lastRow - firstRow + 2, 0);
+
+	//Written back to front, so that a subtile is known to be hidden by those drawn after it when it is reached
+	mesh.resize(n_subTiles * 6);
+	sf::Vertex* v = mesh.data() + mesh.size();
+	occluded = 0;
+	for (auto tileIt = tiles.rbegin(); tileIt != tiles.rend(); ++tileIt) {
+		auto const& [coords, tile] = *tileIt;
+		sf::Vector2f posOffset{ (float) coords.x, (float) coords.y - (float) coords.z / 2 };
+		int column = 2 * (coords.x - left);
+		int row = 2 * coords.y - coords.z - firstRow;
+		for (auto subTileIt = tile.subTiles.rbegin(); subTileIt != tile.subTiles.rend(); ++subTileIt) {
+			SubTile const* subTile = *subTileIt;
+			if (cullOccluded) {
+				SubPositionCells const& cells = subPositionCells[subTile->subPosition];
+				ushort columns = (ushort) (cells.columns << column);
+				bool hidden = true;
+				for (int r = row + cells.firstRow; r < row + cells.endRow; r++)
+					hidden = hidden && (coverage[r] & columns) == columns;
+				if (hidden) {
+					occluded++;
+					continue;
+				}
+				if (subTile->opaque) {
+					for (int r = row + cells.firstRow; r < row + cells.endRow; r++)
+						coverage[r] |= columns;
+				}
+			}
+			v -= 6;
+			writeQuad(subTile->subPosition, v, posOffset, sf::Vector2f(subTile->texturePos), tileSize);
+		}
+	}
+	mesh.erase(mesh.begin(), mesh.begin() + (v - mesh.data()));
+	meshDirty = false;
+}
+
+void Scene::Chunk::updateBounds() const {
+	bounds = sf::FloatRect();
+	if (!tiles.empty()) {
+		float left = std::numeric_limits<float>::max(), top = left;
+		float right = std::numeric_limits<float>::lowest(), bottom = right;
+		for (auto const& [coords, tile] : tiles) {
+			float y = (float) coords.y - (float) coords.z / 2;
+			left = std::min(left, (float) coords.x);
+			right = std::max(right, (float) coords.x + 1);
+			top = std::min(top, y);
+			bottom = std::max(bottom, y + 1);
+		}
+		bounds = sf::FloatRect(left, top, right - left, bottom - top);
+	}
+	boundsDirty = false;
+}
+
+//Area of the scene covered by a view, in scene coordinates
+static sf::FloatRect getVisibleArea(sf::Transform const& transform, sf::View const& view) {
+	return transform.getInverse().transformRect(view.getInverseTransform().transformRect(sf::FloatRect(-1, -1, 2, 2)));
+}
+
 void Scene::draw(sf::RenderTarget& target, sf::RenderStates states) const {
-	states.transform *= getTransform();
+	TRACE_ZONE("Scene::draw");
 	states.texture = &tileset.getTexture();
-	sf::VertexArray va(sf::PrimitiveType::Triangles, currentSprites.size() * 6);
-	int i = 0;
-	for (auto const& [coords, sprite] : currentSprites) {
-		sf::Vector2f posOffset{ coords.x, coords.y - coords.z / 2 };
-		va[i].position = posOffset + sf::Vector2f{ sprite.shapeRect.left, sprite.shapeRect.top };
-		va[i + 1].position = posOffset + sf::Vector2f{ sprite.shapeRect.left + sprite.shapeRect.width, sprite.shapeRect.top };
-		va[i + 2].position = posOffset + sf::Vector2f{ sprite.shapeRect.left, sprite.shapeRect.top + sprite.shapeRect.height };
-		va[i + 3].position = va[i + 2].position;
-		va[i + 4].position = va[i + 1].position;
-		va[i + 5].position = posOffset + sf::Vector2f{ sprite.shapeRect.left + sprite.shapeRect.width, sprite.shapeRect.top + sprite.shapeRect.height };
-
-		va[i].texCoords = { sprite.textureRect.left, sprite.textureRect.top };
-		va[i + 1].texCoords = { sprite.textureRect.left + sprite.textureRect.width, sprite.textureRect.top };
-		va[i + 2].texCoords = { sprite.textureRect.left, sprite.textureRect.top + sprite.textureRect.height };
-		va[i + 3].texCoords = va[i + 2].texCoords;
-		va[i + 4].texCoords = va[i + 1].texCoords;
-		va[i + 5].texCoords = { sprite.textureRect.left + sprite.textureRect.width, sprite.textureRect.top + sprite.textureRect.height };
-		
-		i += 6;
+	drawChunks(target, states);
+}
+
+void Scene::drawChunks(sf::RenderTarget& target, sf::RenderStates states) const {
+	states.transform *= getTransform();
+
+	//Quads only overlap within a column, so drawing chunks row by row keeps the render order of their tiles
+	for (Chunk const* chunk : beginFrame(getVisibleArea(states.transform, target.getView()))) {
+		if (!chunk->mesh.empty())
+			target.draw(chunk->mesh.data(), chunk->mesh.size(), sf::PrimitiveType::Triangles, states);
 	}
-	target.draw(va, states);
+	endFrame();
 }
 
-inline Scene::ChunkCoords Scene::ChunkCoords::fromTileCoords(int x, int y) {
-	return ChunkCoords{
-		x >= 0 ? x / Chunk::resolution : -(-x / Chunk::resolution + 1),
-		y >= 0 ? y / Chunk::resolution : -(-y / Chunk::resolution + 1)
+void Scene::drawHeadless(sf::View const& view) const {
+	TRACE_ZONE("Scene::drawHeadless");
+	beginFrame(getVisibleArea(getTransform(), view));
+	endFrame();
+}
+
+std::vector<Scene::Chunk const*> const& Scene::beginFrame(sf::FloatRect const& visible) const {
+	frame++;
+	float tileSize = (float) tileset.tileSize;
+
+	//Visible chunks are listed first, as unpacking them can modify the chunk map. Chunks outside of the view are neither unpacked nor drawn.
+	visibleChunks.clear();
+	readyChunks.clear();
+	drawStatistics = DrawStatistics();
+	if (minHeight > maxHeight)
+		return readyChunks;
+	//A tile is drawn from its row minus half its height, so only the rows between the top of the visible area raised by the
+	//lowest height and its bottom lowered by the highest one can reach into it, which bounds the chunks to look at
+	auto toTile = [](double coord) {
+		return (int) std::clamp(std::floor(coord), (double) std::numeric_limits<int>::min() / 2, (double) std::numeric_limits<int>::max() / 2);
 	};
+	ChunkCoords min = ChunkCoords::fromTileCoords(toTile(visible.left) - 1, toTile(visible.top + minHeight / 2.0) - 1);
+	ChunkCoords max = ChunkCoords::fromTileCoords(toTile(visible.left + visible.width) + 1, toTile(visible.top + visible.height + maxHeight / 2.0) + 1);
+	chunks.forEachIn(min, max, [&](ChunkCoords coords, Chunk const& chunk) {
+		if (chunk.boundsDirty)
+			chunk.updateBounds();
+		if (visible.intersects(chunk.bounds))
+			visibleChunks.emplace_back(coords, &chunk);
+	});
+
+	for (auto const& [coords, found] : visibleChunks) {
+		Chunk const& chunk = touchChunk(coords, *found);
+		if (chunk.meshDirty)
+			chunk.buildMesh(tileSize, occlusionCulling, occlusionCoverage);
+		drawStatistics.subTiles += chunk.mesh.size() / 6;
+		drawStatistics.occluded += chunk.occluded;
+		readyChunks.push_back(&chunk);
+	}
+	return readyChunks;
 }
 
-inline bool Scene::SpriteCoords::RenderOrderComparator::operator()(SpriteCoords const& before, SpriteCoords const& after) const {
-	if (before.y < after.y)
-		return true;
-	if (before.y > after.y)
-		return false;
-	if (before.x < after.x)
+void Scene::endFrame() const {
+	//Idle chunks are looked for every few frames only, as it means going through all of them
+	if (coldChunkFrames > 0 && frame % 64 == 0)
+		packIdleChunks(coldChunkFrames);
+}
+
+Scene::Chunk const& Scene::touchChunk(ChunkCoords coords, Chunk const& chunk) const {
+	chunk.lastUsed = frame;
+	if (chunk.packed.empty())
+		return chunk;
+
+	Chunk& target = chunks.modify(coords);
+	Chunk unpacked;
+	BinaryReader reader(target.packed.data(), target.packed.size());
+	SceneFile::decodeChunk(reader, coords, tileset, unpacked);
+	target.tiles = std::move(unpacked.tiles);
+	std::vector<char>().swap(target.packed);
+	target.unpackedSize = 0;
+	target.meshDirty = true;
+	target.lastUsed = frame;
+	return target;
+}
+
+void Scene::packChunk(ChunkCoords coords, Chunk& chunk) const {
+	if (chunk.boundsDirty)
+		chunk.updateBounds();
+
+	BinaryWriter writer;
+	SceneFile::encodeChunk(chunk, coords, writer);
+	chunk.unpackedSize = chunk.getMemoryUsage();
+	chunk.packed = writer.getBuffer();
+	Chunk::TileList().swap(chunk.tiles);
+	std::vector<sf::Vertex>().swap(chunk.mesh);
+	chunk.meshDirty = true;
+}
+
+void Scene::packIdleChunks(uint idleFrames) const {
+	chunks.forEach([&](ChunkCoords coords, Chunk const& chunk) {
+		if (!chunk.packed.empty() || chunk.tiles.empty() || frame - chunk.lastUsed < idleFrames)
+			return;
+		//Chunks shared with a snapshot are packed once it is done with them
+		if (Chunk* unshared = chunks.findUnshared(coords))
+			packChunk(coords, *unshared);
+	});
+}
+
+MemoryReport Scene::getMemoryReport() const {
+	MemoryReport report;
+	report.bytes[MemoryReport::chunkContainers] += sizeof(ChunkMap) + chunks.getRowCount() * ChunkMap::rowBytes;
+	chunks.forEach([&](ChunkCoords, Chunk const& chunk) {
+		MemoryReport chunkReport;
+		chunkReport.bytes[MemoryReport::chunkContainers] = ChunkMap::chunkBytes;
+		chunk.reportMemory(chunkReport);
+		report.addChunk(chunkReport.getTotal());
+		for (int i = 0; i < MemoryReport::n_categories; i++)
+			report.bytes[i] += chunkReport.bytes[i];
+		if (!chunk.packed.empty()) {
+			report.packedChunkCount++;
+			report.packedSourceBytes += chunk.unpackedSize;
+		}
+	});
+	return report;
+}
+
+uint Scene::getChecksum() const {
+	uint checksum = checksum32(nullptr, 0);
+	BinaryWriter writer;
+	chunks.forEach([&](ChunkCoords coords, Chunk const& chunk) {
+		if (chunk.isEmpty())
+			return;
+		writer.clear();
+		writer.write(coords);
+		SceneFile::encodeChunk(chunk, coords, writer);
+		checksum = checksum32(writer.getBuffer().data(), writer.size(), checksum);
+	});
+	return checksum;
+}
+
+Scene::~Scene() {
+	if (saveTask.valid())
+		saveTask.wait();
+}
+
+void Scene::save(std::string const& filename) const {
+	SceneFile::save(*this, filename);
+}
+
+void Scene::load(std::string const& filename) {
+	SceneFile(filename, tileset).loadAll(*this);
+}
+
+void Scene::clear() {
+	chunks.clear();
+	minHeight = std::numeric_limits<int>::max();
+	maxHeight = std::numeric_limits<int>::min();
+	changedEverywhere();
+}
+
+void Scene::changedEverywhere() {
+	revision++;
+	fullChangeRevision = revision;
+}
+
+void Scene::includeHeights(Chunk const& chunk) {
+	for (auto const& [coords, tile] : chunk.tiles) {
+		minHeight = std::min(minHeight, coords.z);
+		maxHeight = std::max(maxHeight, coords.z);
+	}
+}
+
+void Scene::setOcclusionCulling(bool enabled) {
+	occlusionCulling = enabled;
+	chunks.forEach([](ChunkCoords, Chunk const& chunk) {
+		chunk.meshDirty = true;
+	});
+	changedEverywhere();
+}
+
+bool Scene::isOcclusionCulling() const {
+	return occlusionCulling;
+}
+
+Scene::DrawStatistics const& Scene::getDrawStatistics() const {
+	return drawStatistics;
+}
+
+ulonglong Scene::getRevision() const {
+	return revision;
+}
+
+bool Scene::getChangedAreas(ulonglong sinceRevision, std::vector<sf::FloatRect>& areas) const {
+	if (sinceRevision >= revision)
 		return true;
-	if (before.x > after.x)
+	//Every revision after the last full change set one tile, so the areas needed are the last revision - sinceRevision ones
+	if (sinceRevision < fullChangeRevision || revision - sinceRevision > changedAreas.size())
 		return false;
-	if (before.z < after.z)
-		return true;
-	if (before.z > after.z)
+	for (auto const& [changeRevision, area] : changedAreas) {
+		if (changeRevision > sinceRevision)
+			areas.push_back(area);
+	}
+	return true;
+}
+
+bool Scene::saveAsync(std::string const& filename) {
+	if (isSaving())
 		return false;
-	if (before.subz < after.subz)
-		return true;
-	return false;
+
+	//The file is written next to its destination and renamed once complete, so that a crash cannot leave it half written
+	saveTask = std::async(std::launch::async, [&tileset = tileset, snapshot = chunks, filename]() {
+		TRACE_THREAD_NAME("scene save");
+		TRACE_ZONE("Scene::saveAsync");
+		std::string tempName = filename + ".tmp";
+		SceneFile::save(tileset, snapshot, tempName);
+		std::error_code error;
+		std::filesystem::rename(tempName, filename, error);
+		if (error)
+			throw GameError("Could not replace scene file " + filename + ": " + error.message());
+	});
+	return true;
+}
+
+bool Scene::isSaving() {
+	if (saveTask.valid() && saveTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		saveTask.get();
+	return saveTask.valid();
+}
+
+void Scene::waitForSave() {
+	if (saveTask.valid())
+		saveTask.get();
+}
+
+Scene::Chunk const* Scene::ChunkMap::find(ChunkCoords coords) const {
+	auto it_r = rows.find(coords.Y);
+	if (it_r == rows.end())
+		return nullptr;
+	auto it_c = it_r->second->find(coords.X);
+	if (it_c == it_r->second->end())
+		return nullptr;
+	return it_c->second.get();
+}
+
+Scene::Chunk& Scene::ChunkMap::modify(ChunkCoords coords) {
+	std::shared_ptr<Chunk>& chunk = modifyRow(coords.Y)[coords.X];
+	if (!chunk)
+		chunk = std::make_shared<Chunk>();
+	else if (chunk.use_count() > 1)
+		chunk = std::make_shared<Chunk>(*chunk);
+
+	//Snapshots only ever release data; make sure their last reads happened before it gets modified
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return *chunk;
+}
+
+Scene::Chunk* Scene::ChunkMap::findUnshared(ChunkCoords coords) {
+	auto it_r = rows.find(coords.Y);
+	if (it_r == rows.end() || it_r->second.use_count() > 1)
+		return nullptr;
+	auto it_c = it_r->second->find(coords.X);
+	if (it_c == it_r->second->end() || it_c->second.use_count() > 1)
+		return nullptr;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return it_c->second.get();
+}
+
+Scene::Chunk& Scene::ChunkMap::reset(ChunkCoords coords) {
+	std::shared_ptr<Chunk>& chunk = modifyRow(coords.Y)[coords.X];
+	chunk = std::make_shared<Chunk>();
+	return *chunk;
+}
+
+Scene::ChunkMap::Row& Scene::ChunkMap::modifyRow(int Y) {
+	std::shared_ptr<Row>& row = rows[Y];
+	if (!row)
+		row = std::make_shared<Row>();
+	else if (row.use_count() > 1)
+		row = std::make_shared<Row>(*row);
+	return *row;
+}
+
+size_t Scene::ChunkMap::getRowCount() const {
+	return rows.size();
+}
+
+void Scene::ChunkMap::clear() {
+	rows.clear();
 }
@@ -1,20 +1,97 @@
 #pragma once
 #include "TileSet.h"
+#include "MemoryReport.h"
+
+class SceneFile;
+class SceneJournal;
 
 class Scene : public sf::Drawable, public sf::Transformable {
 public:
 	Scene(TileSet const& tileset) : tileset(tileset) {}
+	//Waits for a running background save
+	~Scene();
 
 	void setTile(Tile const& t, int x, int y, int z, int subz = 0);
+	//Unpacks the chunk of the tile if it was packed, and counts as a use of it. The returned tile stays valid until the scene is
+	//next edited, loaded or cleared, or its chunk packed: drawing packs it coldChunkFrames draws after its last use at the soonest,
+	//whereas packIdleChunks(0) packs it right away. Tiles are not to be kept across frames.
 	Tile const* getTile(int x, int y, int z, int subz = 0) const;
 
 	TileSet const& getTileSet() const;
 
+	//Changes whenever tiles are set, loaded or cleared, so that a view of the scene knows when to be redrawn
+	ulonglong getRevision() const;
+	//Adds the area covered by each tile set since the given revision, in the scene's coordinates, so that a view of the scene can
+	//redraw only them. Returns false instead if the whole scene may have changed since: it was loaded or cleared, or more tiles
+	//were set than are remembered.
+	bool getChangedAreas(ulonglong sinceRevision, std::vector<sf::FloatRect>& areas) const;
+	static const size_t maxChangedAreas = 1024;
+
+	//Like getTile, both unpack the chunks they go through
 	int getLowestTileHeight(int x, int y, int subz = 0, int min_height = std::numeric_limits<int>::min()) const;
 	int getHighestTileHeight(int x, int y, int subz = 0, int max_height = std::numeric_limits<int>::max()) const;
 
+	//Binary persistence, see SceneFile. Loading replaces the whole content of the scene.
+	//Neither loading nor clearing is recorded by an attached SceneJournal.
+	void save(std::string const& filename) const;
+	void load(std::string const& filename);
+	void clear();
+
+	//Saves the scene as it is now on a background thread, while it keeps being edited. Chunks are shared with the save
+	//until they are modified, so starting it only copies one pointer per row of chunks.
+	//Returns false if the previous save is still running.
+	bool saveAsync(std::string const& filename);
+	//Both rethrow the error of a failed background save
+	bool isSaving();
+	void waitForSave();
+
+	//Chunks neither drawn nor accessed for this many frames are packed in memory when the scene is drawn; 0 disables packing
+	uint coldChunkFrames = 600;
+	//Packs every chunk idle for at least the given number of frames, invalidating the tiles returned by getTile in them
+	void packIdleChunks(uint idleFrames) const;
+
+	//Memory used by the chunks, with a per-chunk histogram; the tileset is not included (see TileSet::getMemoryReport)
+	MemoryReport getMemoryReport() const;
+
+	//Leaves out of the meshes the subtiles entirely hidden by opaque subtiles (see SubTile::opaque) drawn after them in the same chunk.
+	//Occlusion is computed when a chunk is meshed, on a grid of half tiles, which every subposition is aligned on.
+	void setOcclusionCulling(bool enabled);
+	bool isOcclusionCulling() const;
+
+	//Subtiles drawn and left out as hidden by the last draw
+	struct DrawStatistics {
+		size_t subTiles = 0;
+		size_t occluded = 0;
+	};
+	DrawStatistics const& getDrawStatistics() const;
+
+	//Draws the chunks with the given render states as they are, for debug views: the texture coordinates are those of the tileset
+	void drawChunks(sf::RenderTarget& target, sf::RenderStates states) const;
+
+	//Does all the work of drawing the scene through the view but the draw calls: visible chunks are unpacked and meshed, idle ones packed
+	void drawHeadless(sf::View const& view) const;
+
+	//Checksum of the tiles of the scene, whether its chunks are packed or not; the same tiles with the same tileset give the same checksum
+	uint getChecksum() const;
+
 private:
+	friend class SceneFile;
+	friend class SceneJournal;
+
 	TileSet const& tileset;
+	SceneJournal* journal = nullptr;
+	ulonglong revision = 0;
+	//Last revision after which tiles may have changed anywhere
+	ulonglong fullChangeRevision = 0;
+	//Area of each of the last tiles set, with the revision setting it led to; a ring buffer of maxChangedAreas
+	std::vector<std::pair<ulonglong, sf::FloatRect>> changedAreas;
+	size_t nextChangedArea = 0;
+	void changedEverywhere();
+
+	//Range of the heights of the tiles the scene held since it was last cleared: as tiles are drawn higher on the screen the
+	//higher they are, it bounds the rows of chunks which can reach into a visible area
+	int minHeight = std::numeric_limits<int>::max();
+	int maxHeight = std::numeric_limits<int>::min();
 
 	struct Chunk {
 		struct TileCoords {
@@ -25,7 +102,48 @@ private:
 			};
 		};
 
-		std::map<TileCoords, Tile, TileCoords::RenderOrderComparator> tiles;
+		//Tiles sorted in render order; chunks are small so a flat vector beats a node-based map
+		typedef std::vector<std::pair<TileCoords, Tile>> TileList;
+		TileList tiles;
+
+		//Cold chunks hold their tiles encoded like in scene files (see SceneFile) instead, with the tileset's own IDs
+		std::vector<char> packed;
+		size_t unpackedSize = 0;
+
+		//Members below are only used by the main thread, and may change while the chunk is shared with a snapshot
+
+		//Frame the chunk was last drawn or accessed
+		mutable uint lastUsed = 0;
+
+		bool isEmpty() const;
+		//Adds the heap memory owned by the chunk to the report
+		void reportMemory(MemoryReport& report) const;
+		size_t getMemoryUsage() const;
+
+		TileList::const_iterator lowerBound(TileCoords const& coords) const;
+		TileList::const_iterator upperBound(TileCoords const& coords) const;
+		Tile const* findTile(TileCoords const& coords) const;
+		void setTile(TileCoords const& coords, Tile const& tile);
+
+		//Vertices of the chunk's subtiles in render order, rebuilt when the chunk is drawn after a change
+		mutable std::vector<sf::Vertex> mesh;
+		mutable bool meshDirty = true;
+		//Subtiles hidden, left out of the mesh
+		mutable uint occluded = 0;
+
+		//Bounds of the chunk's quads, kept while it is packed so that it can be culled without being unpacked
+		mutable sf::FloatRect bounds;
+		mutable bool boundsDirty = true;
+
+		//Coverage is scratch memory for occlusion culling
+		void buildMesh(float tileSize, bool cullOccluded, std::vector<ushort>& coverage) const;
+		//Past this many rows of half tiles on the screen, a chunk is not culled, as it would need a large coverage grid
+		static const int maxOcclusionRows = 1 << 12;
+		void updateBounds() const;
+
+		Chunk() = default;
+		//Copies the tiles only; the mesh of the copy is built when it is drawn
+		Chunk(Chunk const& other);
 
 		static const int resolution = 8;
 	};
@@ -41,23 +159,112 @@ private:
 		};
 	};
 
-	struct SpriteCoords {
-		float x, y, z;
-		int subz;
+	//Chunks sorted like ChunkCoords::Comparator, stored by row. Rows and chunks are shared between copies of the map
+	//(snapshots) and only copied when modified, so the data of a snapshot never changes and can be read from any thread.
+	class ChunkMap {
+		typedef std::map<int, std::shared_ptr<Chunk>> Row;
 
-		struct RenderOrderComparator {
-			inline bool operator()(SpriteCoords const& before, SpriteCoords const& after) const;
-		};
-	};
+	public:
+		Chunk const* find(ChunkCoords coords) const;
+		//Returns the chunk ready to be modified: it is created if needed, and its row and itself are copied if they are shared
+		Chunk& modify(ChunkCoords coords);
+		//Same as modify but returns nullptr instead of copying shared data
+		Chunk* findUnshared(ChunkCoords coords);
+		//Replaces the chunk with an empty one
+		Chunk& reset(ChunkCoords coords);
+		void clear();
+
+		//Calls f(ChunkCoords, Chunk const&) on every chunk, in order. The map must not be modified meanwhile.
+		template<class F>
+		void forEach(F&& f) const;
+		//Same on the chunks with coordinates within the given bounds (included) only
+		template<class F>
+		void forEachIn(ChunkCoords min, ChunkCoords max, F&& f) const;
+
+		size_t getRowCount() const;
+		//Memory used by a row and by a chunk object, including their map nodes and shared_ptr control blocks
+		static const size_t rowBytes = sizeof(Row) + sizeof(Row::value_type) + MemoryReport::mapNodeOverhead + MemoryReport::sharedPtrControlBlock;
+		static const size_t chunkBytes = sizeof(Chunk) + sizeof(Row::value_type) + MemoryReport::mapNodeOverhead + MemoryReport::sharedPtrControlBlock;
+
+	private:
+		std::map<int, std::shared_ptr<Row>> rows;
 
-	struct Sprite {
-		sf::FloatRect textureRect;
-		sf::FloatRect shapeRect;
+		Row& modifyRow(int Y);
 	};
 
-	std::map<ChunkCoords, Chunk, ChunkCoords::Comparator> chunks;
+	//Packing and unpacking happen in const accessors
+	mutable ChunkMap chunks;
+	mutable uint frame = 0;
+	//Kept between frames so that drawing does not allocate once they are large enough
+	mutable std::vector<std::pair<ChunkCoords, Chunk const*>> visibleChunks;
+	mutable std::vector<Chunk const*> readyChunks;
+	mutable std::vector<ushort> occlusionCoverage;
 
-	std::multimap<SpriteCoords, Sprite, SpriteCoords::RenderOrderComparator> currentSprites;
+	bool occlusionCulling = true;
+	mutable DrawStatistics drawStatistics;
+
+	std::future<void> saveTask;
+
+	//Unpacks the chunk if it is packed and marks it as used this frame; returns the chunk to use from then on
+	Chunk const& touchChunk(ChunkCoords coords, Chunk const& chunk) const;
+	void packChunk(ChunkCoords coords, Chunk& chunk) const;
+	void includeHeights(Chunk const& chunk);
+
+	//Prepares the chunks intersecting the visible area for drawing and returns them in render order
+	std::vector<Chunk const*> const& beginFrame(sf::FloatRect const& visible) const;
+	void endFrame() const;
 
 	virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
 };
+
+inline bool Scene::Chunk::TileCoords::RenderOrderComparator::operator()(TileCoords const& before, TileCoords const& after) const {
+	if (before.y < after.y)
+		return true;
+	if (before.y > after.y)
+		return false;
+	if (before.x < after.x)
+		return true;
+	if (before.x > after.x)
+		return false;
+	if (before.z < after.z)
+		return true;
+	if (before.z > after.z)
+		return false;
+	if (before.subz < after.subz)
+		return true;
+	return false;
+}
+
+inline bool Scene::ChunkCoords::Comparator::operator()(ChunkCoords const& before, ChunkCoords const& after) const {
+	if (before.Y < after.Y)
+		return true;
+	if (before.Y > after.Y)
+		return false;
+	if (before.X < after.X)
+		return true;
+	return false;
+}
+
+template<class F>
+void Scene::ChunkMap::forEach(F&& f) const {
+	for (auto const& [Y, row] : rows) {
+		for (auto const& [X, chunk] : *row)
+			f(ChunkCoords{ X, Y }, *chunk);
+	}
+}
+
+template<class F>
+void Scene::ChunkMap::forEachIn(ChunkCoords min, ChunkCoords max, F&& f) const {
+	for (auto rowIt = rows.lower_bound(min.Y); rowIt != rows.end() && rowIt->first <= max.Y; ++rowIt) {
+		Row const& row = *rowIt->second;
+		for (auto it = row.lower_bound(min.X); it != row.end() && it->first <= max.X; ++it)
+			f(ChunkCoords{ it->first, rowIt->first }, *it->second);
+	}
+}
+
+inline Scene::ChunkCoords Scene::ChunkCoords::fromTileCoords(int x, int y) {
+	return ChunkCoords{
+		x >= 0 ? x / Chunk::resolution : -((-x - 1) / Chunk::resolution + 1),
+		y >= 0 ? y / Chunk::resolution : -((-y - 1) / Chunk::resolution + 1)
+	};
+}
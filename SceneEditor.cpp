@@ -12,6 +12,7 @@ void SceneEditionTool::setScene(Scene& scene) {
 }
 
 void SceneEditionTool::setFilledTile(std::string const& name, int x, int y, int z, bool relayUpdate) const {
+	TRACE_ZONE("SceneEditionTool::setFilledTile");
 	TileSet const& set = scene->getTileSet();
 	Tile tile = set.getEmptyTile(name);
 	TileInfo const& info = *tile.info;
@@ -26,8 +27,8 @@ void SceneEditionTool::setFilledTile(std::string const& name, int x, int y, int
 			setFilledTile(name, x + xOffset, y + yOffset, z + zOffset, relay);
 	};
 
-	const std::vector<std::pair<int, int>> directNeighbours = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
-	const std::vector<std::pair<int, int>> allNeighbours = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+	static const std::pair<int, int> directNeighbours[] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
+	static const std::pair<int, int> allNeighbours[] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
 
 	switch (info.category) {
 	case Tile::terrain_foot: {
@@ -239,6 +240,7 @@ Tile const* SceneEditionTool::checkName(int x, int y, int z, std::string const&
 }
 
 bool TerrainTool::use(int x, int y, int z) const {
+	TRACE_ZONE("TerrainTool::use");
 	int minHeight = scene->getHighestTileHeight(x, y, 0, z);
 	minHeight = std::max(minHeight, lowestHeight);
 
@@ -0,0 +1,309 @@
+#include "SceneFile.h"
+
+struct SceneFileHeader {
+	char magic[4];
+	uint version;
+	uint chunkResolution;
+	uint n_chunks;
+	uint n_tiles;
+	uint n_subTiles;
+};
+
+struct SubTileRecord {
+	uint tile;
+	uchar pattern;
+	uchar subPosition;
+	ushort variant;
+};
+
+static const char sceneFileMagic[4] = { 'R', 'P', 'G', 'S' };
+static const uint sceneFileVersion = 1;
+
+SceneFile::SceneFile(std::string const& filename, TileSet const& tileset) {
+	if (!file.open(filename))
+		throw GameError("Could not open scene file " + filename);
+
+	BinaryReader reader(file.data(), file.size());
+	SceneFileHeader header = reader.read<SceneFileHeader>();
+	if (std::memcmp(header.magic, sceneFileMagic, 4) != 0 || header.version != sceneFileVersion)
+		throw GameError("Invalid scene file " + filename);
+	if (header.chunkResolution != Scene::Chunk::resolution)
+		throw GameError("Scene file " + filename + " uses chunks of " + std::to_string(header.chunkResolution)
+			+ " tiles, expected " + std::to_string(Scene::Chunk::resolution));
+
+	reader.readString(); //Name of the tileset the scene was saved with; tiles are matched by name instead
+
+	//Counts are checked against what is left of the file before anything is allocated for them; a tile name takes at least its length
+	if (header.n_tiles > reader.remaining() / sizeof(uint))
+		throw GameError("Corrupted scene file " + filename);
+	remap.tiles.resize(header.n_tiles);
+	for (uint i = 0; i < header.n_tiles; i++) {
+		std::string name = reader.readString();
+		remap.tiles[i] = tileset.findTileInfo(name);
+		if (remap.tiles[i] == nullptr)
+			throw GameError("Scene file " + filename + " uses tile " + name + ", which is not in tileset " + tileset.getName());
+	}
+
+	if (header.n_subTiles > reader.remaining() / sizeof(SubTileRecord))
+		throw GameError("Corrupted scene file " + filename);
+	std::vector<SubTileRecord> records(header.n_subTiles);
+	reader.readArray(records.data(), records.size());
+	remap.subTiles.resize(header.n_subTiles);
+	for (uint i = 0; i < header.n_subTiles; i++) {
+		SubTileRecord const& r = records[i];
+		if (r.tile >= remap.tiles.size())
+			throw GameError("Corrupted scene file " + filename);
+		Tile tile;
+		tile.info = remap.tiles[r.tile];
+		remap.subTiles[i] = tileset.findSubTile(tile, (SubTile::Pattern) r.pattern, (SubTile::SubPosition) r.subPosition, r.variant);
+		if (remap.subTiles[i] == nullptr)
+			throw GameError("Scene file " + filename + " uses a subtile of " + tile.info->name + " that is not in tileset " + tileset.getName());
+	}
+
+	if (header.n_chunks > reader.remaining() / sizeof(ChunkEntry))
+		throw GameError("Corrupted scene file " + filename);
+	index.resize(header.n_chunks);
+	reader.readArray(index.data(), index.size());
+	for (ChunkEntry const& entry : index) {
+		if (entry.offset > file.size() || entry.size > file.size() - entry.offset)
+			throw GameError("Corrupted scene file " + filename);
+	}
+}
+
+void SceneFile::save(Scene const& scene, std::string const& filename) {
+	save(scene.tileset, scene.chunks, filename);
+}
+
+void SceneFile::save(TileSet const& tileset, Scene::ChunkMap const& chunks, std::string const& filename) {
+	ChunkPayloads payloads;
+	BinaryWriter writer;
+	chunks.forEach([&](Scene::ChunkCoords coords, Scene::Chunk const& chunk) {
+		if (chunk.isEmpty())
+			return;
+		writer.clear();
+		encodeChunk(chunk, coords, writer);
+		payloads.emplace_hint(payloads.end(), coords, writer.getBuffer());
+	});
+	write(tileset, payloads, filename);
+}
+
+void SceneFile::write(TileSet const& tileset, ChunkPayloads const& payloads, std::string const& filename, SceneFile const* base) {
+	BinaryWriter chunkData;
+	std::vector<ChunkEntry> newIndex;
+	newIndex.reserve(payloads.size() + (base ? base->index.size() : 0));
+
+	auto addChunk = [&](Scene::ChunkCoords coords, char const* data, size_t size) {
+		if (size == 0)
+			return;
+		ChunkEntry& entry = newIndex.emplace_back();
+		entry.X = coords.X;
+		entry.Y = coords.Y;
+		entry.size = (uint) size;
+		entry.reserved = 0;
+		entry.offset = chunkData.size();
+		chunkData.append(data, size);
+	};
+
+	//Both sequences are sorted the same way, so they are merged in a single pass; new payloads take precedence
+	Scene::ChunkCoords::Comparator less;
+	auto it_p = payloads.begin();
+	if (base) {
+		for (ChunkEntry const& entry : base->index) {
+			Scene::ChunkCoords coords{ entry.X, entry.Y };
+			for (; it_p != payloads.end() && less(it_p->first, coords); it_p++)
+				addChunk(it_p->first, it_p->second.data(), it_p->second.size());
+			if (it_p != payloads.end() && !less(coords, it_p->first))
+				continue;
+			addChunk(coords, base->file.data() + entry.offset, entry.size);
+		}
+	}
+	for (; it_p != payloads.end(); it_p++)
+		addChunk(it_p->first, it_p->second.data(), it_p->second.size());
+
+	BinaryWriter writer;
+	SceneFileHeader header {};
+	std::memcpy(header.magic, sceneFileMagic, 4);
+	header.version = sceneFileVersion;
+	header.chunkResolution = Scene::Chunk::resolution;
+	header.n_chunks = (uint) newIndex.size();
+	header.n_tiles = (uint) tileset.getTileCount();
+	header.n_subTiles = (uint) tileset.getSubTileCount();
+	writer.write(header);
+	writer.writeString(tileset.getName());
+
+	std::vector<SubTileRecord> records(header.n_subTiles);
+	for (uint i = 0; i < header.n_tiles; i++) {
+		TileInfo const& info = *tileset.findTileInfo(i);
+		writer.writeString(info.name);
+		for (auto const& ranges : info.subTileRanges) {
+			for (TileInfo::SubTileRange const& range : ranges) {
+				for (uint id = range.offset; id < range.offset + range.count; id++) {
+					SubTile const& st = *tileset.findSubTile(id);
+					records[id] = { i, st.pattern, st.subPosition, st.variant };
+				}
+			}
+		}
+	}
+	writer.writeArray(records.data(), records.size());
+
+	ulonglong payloadStart = writer.size() + sizeof(ChunkEntry) * newIndex.size();
+	for (ChunkEntry& entry : newIndex)
+		entry.offset += payloadStart;
+	writer.writeArray(newIndex.data(), newIndex.size());
+	writer.append(chunkData.getBuffer().data(), chunkData.size());
+
+	if (!writer.saveToFile(filename))
+		throw GameError("Could not write scene file " + filename);
+}
+
+bool SceneFile::usesIDsOf(TileSet const& tileset) const {
+	if (remap.tiles.size() != tileset.getTileCount() || remap.subTiles.size() != tileset.getSubTileCount())
+		return false;
+	for (uint i = 0; i < remap.tiles.size(); i++) {
+		if (remap.tiles[i] != tileset.findTileInfo(i))
+			return false;
+	}
+	for (uint i = 0; i < remap.subTiles.size(); i++) {
+		if (remap.subTiles[i] != tileset.findSubTile(i))
+			return false;
+	}
+	return true;
+}
+
+size_t SceneFile::getChunkCount() const {
+	return index.size();
+}
+
+bool SceneFile::loadChunk(Scene& scene, int X, int Y) const {
+	Scene::ChunkCoords coords{ X, Y };
+	auto it = std::lower_bound(index.begin(), index.end(), coords, [](ChunkEntry const& entry, Scene::ChunkCoords const& c) {
+		return Scene::ChunkCoords::Comparator()({ entry.X, entry.Y }, c);
+	});
+	if (it == index.end() || it->X != X || it->Y != Y)
+		return false;
+
+	Scene::Chunk& chunk = scene.chunks.reset(coords);
+	decodeEntry(*it, chunk);
+	scene.includeHeights(chunk);
+	scene.changedEverywhere();
+	return true;
+}
+
+void SceneFile::loadAll(Scene& scene) const {
+	scene.clear();
+	for (ChunkEntry const& entry : index) {
+		Scene::Chunk& chunk = scene.chunks.reset({ entry.X, entry.Y });
+		decodeEntry(entry, chunk);
+		scene.includeHeights(chunk);
+	}
+	scene.changedEverywhere();
+}
+
+void SceneFile::decodeEntry(ChunkEntry const& entry, Scene::Chunk& chunk) const {
+	BinaryReader reader(file.data() + entry.offset, entry.size);
+	decodeChunk(reader, { entry.X, entry.Y }, remap, chunk);
+}
+
+SceneFile::IDRemap SceneFile::IDRemap::identity(TileSet const& tileset) {
+	IDRemap remap;
+	remap.tiles.resize(tileset.getTileCount());
+	for (uint i = 0; i < remap.tiles.size(); i++)
+		remap.tiles[i] = tileset.findTileInfo(i);
+	remap.subTiles.resize(tileset.getSubTileCount());
+	for (uint i = 0; i < remap.subTiles.size(); i++)
+		remap.subTiles[i] = tileset.findSubTile(i);
+	return remap;
+}
+
+/* Chunk payload: tile count, then for each tile in render order:
+ * column index delta, z delta, subz, tile ID delta, subtile count and subtile ID deltas.
+ * Deltas run across the whole chunk so that stacks of similar tiles encode in a few bytes each.
+ */
+void SceneFile::encodeChunk(Scene::Chunk const& chunk, Scene::ChunkCoords coords, BinaryWriter& writer) {
+	//Packed chunks already hold their payload
+	if (!chunk.packed.empty()) {
+		writer.append(chunk.packed.data(), chunk.packed.size());
+		return;
+	}
+
+	const int res = Scene::Chunk::resolution;
+	writer.writeVarint(chunk.tiles.size());
+
+	int prevColumn = 0, prevZ = 0;
+	longlong prevTile = 0, prevSubTile = 0;
+	for (auto const& [tc, tile] : chunk.tiles) {
+		if (tile.info == nullptr)
+			throw GameError("Tried to save a tile without info at " + vec3ToString(sf::Vector3i(tc.x, tc.y, tc.z)));
+		int column = (tc.y - coords.Y * res) * res + (tc.x - coords.X * res);
+		writer.writeVarint(column - prevColumn);
+		writer.writeSignedVarint(tc.z - prevZ);
+		writer.writeSignedVarint(tc.subz);
+		writer.writeSignedVarint(tile.info->ID - prevTile);
+		writer.writeVarint(tile.subTiles.size());
+		for (SubTile const* st : tile.subTiles) {
+			writer.writeSignedVarint(st->ID - prevSubTile);
+			prevSubTile = st->ID;
+		}
+		prevColumn = column;
+		prevZ = tc.z;
+		prevTile = tile.info->ID;
+	}
+}
+
+template<class TileLookup, class SubTileLookup>
+void SceneFile::decodeTiles(BinaryReader& reader, Scene::ChunkCoords coords, TileLookup findTile, SubTileLookup findSubTile, Scene::Chunk::TileList& tiles) {
+	const int res = Scene::Chunk::resolution;
+	ulonglong n_tiles = reader.readVarint();
+	tiles.reserve(std::min<ulonglong>(n_tiles, reader.remaining()));
+
+	int column = 0, z = 0;
+	longlong tileID = 0, subTileID = 0;
+	for (ulonglong i = 0; i < n_tiles; i++) {
+		//Bounded before the cast, so that a corrupt delta cannot wrap the column out of the chunk
+		ulonglong columnDelta = reader.readVarint();
+		if (columnDelta >= (ulonglong) (res * res))
+			throw GameError("Corrupted chunk data in chunk " + vec2ToString(sf::Vector2i(coords.X, coords.Y)));
+		column += (int) columnDelta;
+		z += (int) reader.readSignedVarint();
+		int subz = (int) reader.readSignedVarint();
+		tileID += reader.readSignedVarint();
+
+		Tile tile;
+		tile.info = tileID >= 0 ? findTile((ulonglong) tileID) : nullptr;
+		if (column < 0 || column >= res * res || tile.info == nullptr)
+			throw GameError("Corrupted chunk data in chunk " + vec2ToString(sf::Vector2i(coords.X, coords.Y)));
+
+		ulonglong n_subTiles = reader.readVarint();
+		tile.subTiles.reserve(std::min<ulonglong>(n_subTiles, reader.remaining()));
+		for (ulonglong s = 0; s < n_subTiles; s++) {
+			subTileID += reader.readSignedVarint();
+			SubTile const* subTile = subTileID >= 0 ? findSubTile((ulonglong) subTileID) : nullptr;
+			if (subTile == nullptr)
+				throw GameError("Corrupted chunk data in chunk " + vec2ToString(sf::Vector2i(coords.X, coords.Y)));
+			tile.subTiles.push_back(subTile);
+		}
+
+		Scene::Chunk::TileCoords tc{ coords.X * res + column % res, coords.Y * res + column / res, z, subz };
+		if (!tiles.empty() && !Scene::Chunk::TileCoords::RenderOrderComparator()(tiles.back().first, tc))
+			throw GameError("Corrupted chunk data in chunk " + vec2ToString(sf::Vector2i(coords.X, coords.Y)));
+		tiles.emplace_back(tc, std::move(tile));
+	}
+}
+
+void SceneFile::decodeChunk(BinaryReader& reader, Scene::ChunkCoords coords, IDRemap const& remap, Scene::Chunk& chunk) {
+	decodeTiles(reader, coords,
+		[&](ulonglong id) { return id < remap.tiles.size() ? remap.tiles[id] : nullptr; },
+		[&](ulonglong id) { return id < remap.subTiles.size() ? remap.subTiles[id] : nullptr; },
+		chunk.tiles);
+	chunk.meshDirty = true;
+	chunk.boundsDirty = true;
+}
+
+void SceneFile::decodeChunk(BinaryReader& reader, Scene::ChunkCoords coords, TileSet const& tileset, Scene::Chunk& chunk) {
+	decodeTiles(reader, coords,
+		[&](ulonglong id) { return id < tileset.getTileCount() ? tileset.findTileInfo((uint) id) : nullptr; },
+		[&](ulonglong id) { return id < tileset.getSubTileCount() ? tileset.findSubTile((uint) id) : nullptr; },
+		chunk.tiles);
+	chunk.meshDirty = true;
+	chunk.boundsDirty = true;
+}
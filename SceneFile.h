@@ -0,0 +1,68 @@
+#pragma once
+#include "Scene.h"
+#include "Binary.h"
+#include "MappedFile.h"
+
+/* Binary scene file:
+ * header, tileset name, ID remap table (the name of each saved tile ID, then the tile, pattern, subposition
+ * and variant of each saved subtile ID), chunk index (coordinates, offset and size of each chunk payload),
+ * then the chunk payloads.
+ * Payloads are varint / delta encoded and can each be decoded on their own, straight from the file mapping.
+ */
+class SceneFile {
+public:
+	//Maps the file and reads everything but the chunk payloads; saved IDs are remapped by name onto the given tileset
+	SceneFile(std::string const& filename, TileSet const& tileset);
+
+	static void save(Scene const& scene, std::string const& filename);
+	//Saves a snapshot of a scene's chunks; safe to call from any thread
+	static void save(TileSet const& tileset, Scene::ChunkMap const& chunks, std::string const& filename);
+
+	//Encoded chunk payloads, sorted like Scene::chunks; an empty payload stands for a removed chunk
+	typedef std::map<Scene::ChunkCoords, std::vector<char>, Scene::ChunkCoords::Comparator> ChunkPayloads;
+
+	//Writes a scene file made of the given payloads, encoded with the tileset's own IDs. Chunks of the base file that are
+	//not in the payloads are copied over without being decoded, which requires the base to use the same IDs (see usesIDsOf).
+	static void write(TileSet const& tileset, ChunkPayloads const& payloads, std::string const& filename, SceneFile const* base = nullptr);
+
+	//Whether the IDs stored in this file's payloads are those of the tileset, i.e. the remap is an identity
+	bool usesIDsOf(TileSet const& tileset) const;
+
+	size_t getChunkCount() const;
+
+	//Decodes a single chunk into the scene, replacing the chunk there; returns false if the file has no such chunk
+	bool loadChunk(Scene& scene, int X, int Y) const;
+	void loadAll(Scene& scene) const;
+
+	//Maps the IDs stored in chunk payloads to tiles of the tileset they are loaded with
+	struct IDRemap {
+		std::vector<TileInfo const*> tiles;
+		std::vector<SubTile const*> subTiles;
+
+		static IDRemap identity(TileSet const& tileset);
+	};
+
+	//Chunk payload encoding
+	static void encodeChunk(Scene::Chunk const& chunk, Scene::ChunkCoords coords, BinaryWriter& writer);
+	static void decodeChunk(BinaryReader& reader, Scene::ChunkCoords coords, IDRemap const& remap, Scene::Chunk& chunk);
+	//Decodes a payload stored with the tileset's own IDs, as packed chunks are
+	static void decodeChunk(BinaryReader& reader, Scene::ChunkCoords coords, TileSet const& tileset, Scene::Chunk& chunk);
+
+private:
+	struct ChunkEntry {
+		int X, Y;
+		uint size;
+		uint reserved;
+		ulonglong offset;
+	};
+
+	void decodeEntry(ChunkEntry const& entry, Scene::Chunk& chunk) const;
+
+	//Lookups take a stored ID and return nullptr if it is out of range
+	template<class TileLookup, class SubTileLookup>
+	static void decodeTiles(BinaryReader& reader, Scene::ChunkCoords coords, TileLookup findTile, SubTileLookup findSubTile, Scene::Chunk::TileList& tiles);
+
+	MappedFile file;
+	std::vector<ChunkEntry> index;	//Sorted like Scene::chunks
+	IDRemap remap;
+};
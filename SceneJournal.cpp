@@ -0,0 +1,285 @@
+#include <chrono>
+#include "SceneJournal.h"
+
+struct SceneLogHeader {
+	char magic[4];
+	uint version;
+};
+
+struct SceneLogFrame {
+	uint size;
+	uint checksum;
+};
+
+static const char sceneLogMagic[4] = { 'R', 'P', 'G', 'L' };
+static const uint sceneLogVersion = 1;
+
+SceneJournal::SceneJournal(Scene& scene, std::string const& filename) :
+	scene(scene), filename(filename), logName(filename + ".log"), oldLogName(filename + ".log.old")
+{
+	if (scene.journal != nullptr)
+		throw GameError("Scene is already journaled");
+
+	if (std::filesystem::exists(filename)) {
+		base = std::make_unique<SceneFile>(filename, scene.tileset);
+		base->loadAll(scene);
+	}
+	else {
+		scene.clear();
+	}
+
+	//A log left aside by an interrupted compaction holds edits older than those of the current log
+	replay(oldLogName);
+	replay(logName);
+	openLog();
+
+	scene.journal = this;
+}
+
+SceneJournal::~SceneJournal() {
+	scene.journal = nullptr;
+	try {
+		waitForCompaction();
+		writePending();
+	}
+	catch (std::exception const& e) {
+		std::cerr << "Could not close scene journal " << logName << ": " << e.what() << std::endl;
+	}
+}
+
+void SceneJournal::record(Tile const& t, int x, int y, int z, int subz) {
+	pending.writeSignedVarint(x);
+	pending.writeSignedVarint(y);
+	pending.writeSignedVarint(z);
+	pending.writeSignedVarint(subz);
+	pending.writeString(t.info ? t.info->name : std::string());
+	pending.writeVarint(t.subTiles.size());
+	for (SubTile const* st : t.subTiles) {
+		pending.write(st->pattern);
+		pending.write(st->subPosition);
+		pending.writeVarint(st->variant);
+	}
+	pendingRecords++;
+	changedChunks.insert(Scene::ChunkCoords::fromTileCoords(x, y));
+}
+
+void SceneJournal::flush() {
+	writePending();
+	if (logSize > compactionThreshold)
+		compact();
+}
+
+void SceneJournal::writePending() {
+	if (pendingRecords > 0) {
+		BinaryWriter frame;
+		frame.writeVarint(pendingRecords);
+		frame.append(pending.getBuffer().data(), pending.size());
+
+		SceneLogFrame header{ (uint) frame.size(), checksum32(frame.getBuffer().data(), frame.size()) };
+		log.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		log.write(frame.getBuffer().data(), frame.size());
+		log.flush();
+		if (!log.good())
+			throw GameError("Could not write to scene log " + logName);
+
+		logSize += sizeof(header) + frame.size();
+		pending.clear();
+		pendingRecords = 0;
+	}
+}
+
+void SceneJournal::compact() {
+	collectCompaction();
+	if (compaction.valid())
+		return;
+
+	writePending();
+	rotateLog();
+
+	//Chunks are encoded from a snapshot, so that the scene can keep changing while the file is written.
+	//Without a base file using the tileset's IDs, every chunk has to be encoded again.
+	TileSet const& tileset = scene.tileset;
+	if (base && !base->usesIDsOf(tileset))
+		base.reset();
+	std::vector<Scene::ChunkCoords> changed;
+	if (base)
+		changed.assign(changedChunks.begin(), changedChunks.end());
+	changedChunks.clear();
+
+	compaction = std::async(std::launch::async,
+		[&tileset, filename = filename, oldLogName = oldLogName, snapshot = scene.chunks, changed = std::move(changed), base = std::move(base)]() mutable {
+			TRACE_THREAD_NAME("scene compaction");
+			TRACE_ZONE("SceneJournal::compact");
+			SceneFile::ChunkPayloads payloads;
+			BinaryWriter writer;
+			auto encode = [&](Scene::ChunkCoords coords, Scene::Chunk const* chunk) {
+				writer.clear();
+				if (chunk && !chunk->isEmpty())
+					SceneFile::encodeChunk(*chunk, coords, writer);
+				payloads.emplace_hint(payloads.end(), coords, writer.getBuffer());
+			};
+			if (base) {
+				for (Scene::ChunkCoords coords : changed)
+					encode(coords, snapshot.find(coords));
+			}
+			else {
+				snapshot.forEach([&](Scene::ChunkCoords coords, Scene::Chunk const& chunk) { encode(coords, &chunk); });
+			}
+
+			std::string tempName = filename + ".tmp";
+			SceneFile::write(tileset, payloads, tempName, base.get());
+			base.reset(); //The previous file cannot be replaced while it is mapped on Windows
+
+			std::error_code error;
+			std::filesystem::rename(tempName, filename, error);
+			if (error)
+				throw GameError("Could not replace scene file " + filename + ": " + error.message());
+			std::filesystem::remove(oldLogName, error);
+
+			return std::make_unique<SceneFile>(filename, tileset);
+		});
+}
+
+bool SceneJournal::isCompacting() {
+	collectCompaction();
+	return compaction.valid();
+}
+
+void SceneJournal::waitForCompaction() {
+	if (compaction.valid())
+		takeCompaction();
+}
+
+size_t SceneJournal::getLogSize() const {
+	return logSize + pending.size();
+}
+
+size_t SceneJournal::getChangedChunkCount() const {
+	return changedChunks.size();
+}
+
+bool SceneJournal::replay(std::string const& name) {
+	std::vector<char> data;
+	if (!readWholeFile(name, data))
+		return false;
+
+	//A crash while creating the log can leave its header incomplete; such a log holds no records
+	size_t validEnd = 0;
+	if (data.size() >= sizeof(SceneLogHeader)) {
+		BinaryReader reader(data.data(), data.size());
+		SceneLogHeader header = reader.read<SceneLogHeader>();
+		if (std::memcmp(header.magic, sceneLogMagic, 4) != 0 || header.version != sceneLogVersion)
+			throw GameError("Invalid scene log " + name);
+		validEnd = reader.tell();
+
+		TileSet const& tileset = scene.tileset;
+		while (reader.remaining() >= sizeof(SceneLogFrame)) {
+			SceneLogFrame frame = reader.read<SceneLogFrame>();
+			if (frame.size > reader.remaining())
+				break;
+			char const* frameData = reader.skip(frame.size);
+			if (checksum32(frameData, frame.size) != frame.checksum)
+				break;
+
+			BinaryReader records(frameData, frame.size);
+			ulonglong n_records = records.readVarint();
+			for (ulonglong i = 0; i < n_records; i++) {
+				int x = (int) records.readSignedVarint();
+				int y = (int) records.readSignedVarint();
+				int z = (int) records.readSignedVarint();
+				int subz = (int) records.readSignedVarint();
+
+				Tile tile;
+				std::string tileName = records.readString();
+				if (!tileName.empty()) {
+					tile.info = tileset.findTileInfo(tileName);
+					if (tile.info == nullptr)
+						throw GameError("Scene log " + name + " uses tile " + tileName + ", which is not in tileset " + tileset.getName());
+				}
+				ulonglong n_subTiles = records.readVarint();
+				for (ulonglong s = 0; s < n_subTiles; s++) {
+					SubTile::Pattern pattern = records.read<SubTile::Pattern>();
+					SubTile::SubPosition subPos = records.read<SubTile::SubPosition>();
+					size_t variant = (size_t) records.readVarint();
+					SubTile const* st = tileset.findSubTile(tile, pattern, subPos, variant);
+					if (st == nullptr)
+						throw GameError("Scene log " + name + " uses a subtile of " + tileName + " that is not in tileset " + tileset.getName());
+					tile.subTiles.push_back(st);
+				}
+
+				scene.setTile(tile, x, y, z, subz);
+				changedChunks.insert(Scene::ChunkCoords::fromTileCoords(x, y));
+			}
+			validEnd = reader.tell();
+		}
+	}
+
+	if (validEnd < data.size()) {
+		std::error_code error;
+		std::filesystem::resize_file(name, validEnd, error);
+		if (error)
+			throw GameError("Could not truncate scene log " + name + ": " + error.message());
+	}
+	return true;
+}
+
+void SceneJournal::openLog() {
+	std::error_code error;
+	size_t size = (size_t) std::filesystem::file_size(logName, error);
+	if (error || size < sizeof(SceneLogHeader)) {
+		BinaryWriter writer;
+		SceneLogHeader header{};
+		std::memcpy(header.magic, sceneLogMagic, 4);
+		header.version = sceneLogVersion;
+		writer.write(header);
+		if (!writer.saveToFile(logName))
+			throw GameError("Could not create scene log " + logName);
+		size = writer.size();
+	}
+
+	log.open(logName, std::ios::binary | std::ios::app);
+	if (!log.is_open())
+		throw GameError("Could not open scene log " + logName);
+	logSize = size;
+}
+
+void SceneJournal::rotateLog() {
+	log.close();
+
+	std::error_code error;
+	if (std::filesystem::exists(oldLogName)) {
+		//The previous compaction failed: both logs are folded by the next one
+		std::vector<char> data;
+		if (!readWholeFile(logName, data))
+			throw GameError("Could not read scene log " + logName);
+		std::ofstream old(oldLogName, std::ios::binary | std::ios::app);
+		old.write(data.data() + sizeof(SceneLogHeader), data.size() - sizeof(SceneLogHeader));
+		if (!old.good())
+			throw GameError("Could not write to scene log " + oldLogName);
+		old.close();
+		std::filesystem::remove(logName, error);
+	}
+	else {
+		std::filesystem::rename(logName, oldLogName, error);
+	}
+	if (error)
+		throw GameError("Could not set scene log " + logName + " aside: " + error.message());
+
+	openLog();
+}
+
+void SceneJournal::collectCompaction() {
+	if (compaction.valid() && compaction.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		takeCompaction();
+}
+
+void SceneJournal::takeCompaction() {
+	try {
+		base = compaction.get();
+	}
+	catch (std::exception const& e) {
+		//Nothing is lost: the log set aside stays and is folded by the next compaction along with the current one.
+		//That compaction has no base file, so it encodes every chunk, including those this one was given.
+		std::cerr << "Could not compact scene file " << filename << ": " << e.what() << std::endl;
+	}
+}
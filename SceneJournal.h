@@ -0,0 +1,68 @@
+#pragma once
+#include "SceneFile.h"
+
+/* Keeps a scene in sync with a scene file (see SceneFile) and an append-only log of its edits (<filename>.log).
+ * Every Scene::setTile is recorded; records are appended to the log in checksummed frames when flushed, so that a crash
+ * loses at most the unflushed edits and a torn frame is dropped on recovery.
+ * Compaction folds the log into the scene file on a background thread: only the chunks edited since the last compaction are
+ * encoded, the payloads of the other chunks are copied from the previous file as they are.
+ * Records hold absolute tile values, so replaying a log onto a file it was already folded into is harmless.
+ */
+class SceneJournal {
+public:
+	//Loads the scene file if it exists, replays the logs left over from the previous session, then starts recording the scene's edits
+	SceneJournal(Scene& scene, std::string const& filename);
+	//Waits for a running compaction and flushes the remaining records; does not compact
+	~SceneJournal();
+
+	SceneJournal(SceneJournal const&) = delete;
+	SceneJournal& operator=(SceneJournal const&) = delete;
+
+	//Appends the buffered records to the log. Starts a compaction if the log grew past the threshold.
+	void flush();
+
+	//Starts folding the log into the scene file in the background; does nothing if a compaction is already running.
+	//A compaction failing leaves the logs to the next one.
+	void compact();
+	bool isCompacting();
+	void waitForCompaction();
+
+	size_t getLogSize() const;
+	size_t getChangedChunkCount() const;
+
+	//Log size past which flush starts a compaction
+	size_t compactionThreshold = 1 << 20;
+
+private:
+	friend class Scene;
+
+	void record(Tile const& t, int x, int y, int z, int subz);
+	void writePending();
+
+	//Replays the valid frames of a log into the scene; a torn or corrupted tail is cut off. Returns false if there is no log.
+	bool replay(std::string const& logName);
+	void openLog();
+	//Moves the current log aside so that compaction can fold it while new edits go to a fresh log
+	void rotateLog();
+	//Takes back the new scene file if the compaction is finished
+	void collectCompaction();
+	//Waits for the compaction and takes back the new scene file; a failed compaction is reported, not thrown, so that a full
+	//disk does not bring the editor down
+	void takeCompaction();
+
+	Scene& scene;
+	std::string filename;
+	std::string logName;
+	std::string oldLogName;
+
+	std::ofstream log;
+	size_t logSize = 0;
+	BinaryWriter pending;
+	uint pendingRecords = 0;
+
+	std::set<Scene::ChunkCoords, Scene::ChunkCoords::Comparator> changedChunks;
+
+	//Current scene file, handed over to the compaction task while it runs
+	std::unique_ptr<SceneFile> base;
+	std::future<std::unique_ptr<SceneFile>> compaction;
+};
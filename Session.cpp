@@ -0,0 +1,251 @@
+#include <iomanip>
+#include <thread>
+#include "Session.h"
+#include "AllocationTracker.h"
+
+struct SessionHeader {
+	char magic[4];
+	uint version;
+};
+
+static const char sessionMagic[4] = { 'R', 'P', 'G', 'R' };
+static const uint sessionVersion = 1;
+
+SessionRecorder::SessionRecorder(Scene const& scene, TerrainTool const& tool, std::string const& filename) :
+	filename(filename), lastRecord(std::chrono::steady_clock::now())
+{
+	//The previous session is kept as <filename>.old, with its scene, so that it can still be replayed
+	std::string oldName = filename + ".old";
+	std::error_code error;
+	if (std::filesystem::exists(filename, error)) {
+		std::filesystem::rename(filename, oldName, error);
+		if (!error && std::filesystem::exists(filename + ".scene", error))
+			std::filesystem::rename(filename + ".scene", oldName + ".scene", error);
+		if (error)
+			throw GameError("Could not set previous session " + filename + " aside: " + error.message());
+	}
+
+	scene.save(filename + ".scene");
+
+	SessionHeader header{};
+	std::memcpy(header.magic, sessionMagic, 4);
+	header.version = sessionVersion;
+	pending.write(header);
+	pending.writeString(scene.getTileSet().getName());
+	pending.writeString(tool.top);
+	pending.writeString(tool.wall);
+	pending.writeString(tool.foot);
+	pending.writeSignedVarint(tool.lowestHeight);
+
+	file.open(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw GameError("Could not create session file " + filename);
+	flush();
+}
+
+SessionRecorder::~SessionRecorder() {
+	try {
+		flush();
+	}
+	catch (std::exception const& e) {
+		std::cerr << e.what() << std::endl;
+	}
+}
+
+void SessionRecorder::beginRecord(RecordType type) {
+	auto now = std::chrono::steady_clock::now();
+	pending.write(type);
+	pending.writeVarint(std::chrono::duration_cast<std::chrono::microseconds>(now - lastRecord).count());
+	lastRecord = now;
+}
+
+void SessionRecorder::recordUse(int x, int y, int z) {
+	beginRecord(use);
+	pending.writeSignedVarint(x);
+	pending.writeSignedVarint(y);
+	pending.writeSignedVarint(z);
+}
+
+void SessionRecorder::recordView(sf::View const& v) {
+	if (viewRecorded && v.getCenter() == viewCenter && v.getSize() == viewSize && v.getRotation() == viewRotation)
+		return;
+	viewCenter = v.getCenter();
+	viewSize = v.getSize();
+	viewRotation = v.getRotation();
+	viewRecorded = true;
+
+	beginRecord(view);
+	pending.write(viewCenter);
+	pending.write(viewSize);
+	pending.write(viewRotation);
+}
+
+void SessionRecorder::recordFrame() {
+	beginRecord(frame);
+	if (pending.size() >= blockSize)
+		flush();
+}
+
+void SessionRecorder::flush() {
+	if (pending.size() > 0) {
+		file.write(pending.getBuffer().data(), pending.size());
+		file.flush();
+		if (!file.good())
+			throw GameError("Could not write to session file " + filename);
+		pending.clear();
+	}
+}
+
+namespace {
+	struct SessionRecord {
+		SessionRecorder::RecordType type;
+		//Time since the start of the session
+		std::chrono::microseconds time;
+		sf::Vector3i use;
+		sf::View view;
+	};
+
+	std::string formatStats(std::vector<double> times, std::string const& unit) {
+		if (times.empty())
+			return "none";
+		std::sort(times.begin(), times.end());
+		double total = std::accumulate(times.begin(), times.end(), 0.0);
+		std::ostringstream oss;
+		oss << times.size() << ", mean " << total / times.size() << unit
+			<< ", median " << times[times.size() / 2] << unit
+			<< ", 99th percentile " << times[times.size() * 99 / 100] << unit
+			<< ", max " << times.back() << unit;
+		return oss.str();
+	}
+
+	double elapsedMs(std::chrono::steady_clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+	}
+}
+
+int runReplayTool(std::vector<std::string> const& args) {
+	if (args.size() < 2) {
+		std::cerr << "Usage: --replay <session> [--realtime] [--alloc-budget <allocations per frame>]" << std::endl;
+		return 1;
+	}
+	std::string filename = args[1];
+	bool realtime = false;
+	for (size_t i = 2; i < args.size(); i++) {
+		if (args[i] == "--realtime")
+			realtime = true;
+		else if (args[i] == "--alloc-budget" && i + 1 < args.size())
+			AllocationTracker::setFrameBudget(std::stoull(args[++i]));
+	}
+
+	std::vector<char> data;
+	if (!readWholeFile(filename, data))
+		throw GameError("Could not read session file " + filename);
+	BinaryReader reader(data.data(), data.size());
+	SessionHeader header = reader.read<SessionHeader>();
+	if (std::memcmp(header.magic, sessionMagic, 4) != 0 || header.version != sessionVersion)
+		throw GameError("Invalid session file " + filename);
+
+	TileSet const& set = TileSet::get(reader.readString());
+	Scene scene(set);
+	TerrainTool tool;
+	tool.setScene(scene);
+	tool.top = reader.readString();
+	tool.wall = reader.readString();
+	tool.foot = reader.readString();
+	tool.lowestHeight = (int) reader.readSignedVarint();
+
+	//Records are all decoded beforehand so that decoding is not part of the timings.
+	//A session cut short by a crash can end with an incomplete record, which is dropped.
+	std::vector<SessionRecord> records;
+	std::chrono::microseconds time(0);
+	try {
+		while (!reader.atEnd()) {
+			SessionRecord record{};
+			record.type = reader.read<SessionRecorder::RecordType>();
+			time += std::chrono::microseconds(reader.readVarint());
+			record.time = time;
+			switch (record.type) {
+			case SessionRecorder::use:
+				record.use.x = (int) reader.readSignedVarint();
+				record.use.y = (int) reader.readSignedVarint();
+				record.use.z = (int) reader.readSignedVarint();
+				break;
+			case SessionRecorder::view: {
+				sf::Vector2f center = reader.read<sf::Vector2f>();
+				sf::Vector2f size = reader.read<sf::Vector2f>();
+				record.view = sf::View(center, size);
+				record.view.setRotation(reader.read<float>());
+				break;
+			}
+			case SessionRecorder::frame:
+				break;
+			default:
+				throw GameError("Invalid record in session file " + filename);
+			}
+			records.push_back(record);
+		}
+	}
+	catch (GameError const& e) {
+		std::cerr << e.what() << "; replaying the " << records.size() << " records before it" << std::endl;
+	}
+
+	std::string sceneFile = filename + ".scene";
+	if (std::filesystem::exists(sceneFile))
+		scene.load(sceneFile);
+
+	std::vector<double> useTimes, frameTimes;
+	std::vector<double> useAllocations, frameAllocations;
+	sf::View view;
+	//Frames following an edit or a view change rebuild meshes; the others are expected to stay within the allocation budget
+	bool steadyFrame = false;
+	auto start = std::chrono::steady_clock::now();
+	for (SessionRecord const& record : records) {
+		if (realtime)
+			std::this_thread::sleep_until(start + record.time);
+
+		auto recordStart = std::chrono::steady_clock::now();
+		AllocationTracker::Scope allocations;
+		switch (record.type) {
+		case SessionRecorder::use: {
+			tool.use(record.use.x, record.use.y, record.use.z);
+			AllocationTracker::Counts useCounts = allocations.get();
+			useTimes.push_back(elapsedMs(recordStart) * 1000);
+			useAllocations.push_back((double) useCounts.allocations);
+			steadyFrame = false;
+			break;
+		}
+		case SessionRecorder::view:
+			view = record.view;
+			steadyFrame = false;
+			break;
+		case SessionRecorder::frame: {
+			scene.drawHeadless(view);
+			AllocationTracker::Counts frameCounts = allocations.get();
+			frameTimes.push_back(elapsedMs(recordStart));
+			frameAllocations.push_back((double) frameCounts.allocations);
+			if (steadyFrame)
+				AllocationTracker::checkFrameBudget(frameCounts);
+			steadyFrame = true;
+			break;
+		}
+		}
+	}
+	double replayMs = elapsedMs(start);
+
+	std::cout << "session: " << filename << ", " << records.size() << " records over "
+		<< (records.empty() ? 0.0 : records.back().time.count() / 1e6) << " s" << std::endl;
+	std::cout << "replay: " << replayMs << " ms" << (realtime ? " (real time)" : "") << std::endl;
+	std::cout << "tool uses: " << formatStats(useTimes, " us") << std::endl;
+	std::cout << "frames: " << formatStats(frameTimes, " ms") << std::endl;
+	if (AllocationTracker::enabled) {
+		std::cout << "allocations per tool use: " << formatStats(useAllocations, "") << std::endl;
+		std::cout << "allocations per frame: " << formatStats(frameAllocations, "") << std::endl;
+	}
+	else {
+		std::cout << "allocations: not tracked (build with RPG_TRACK_ALLOCATIONS)" << std::endl;
+	}
+	std::cout << "scene checksum: " << std::hex << std::setw(8) << std::setfill('0') << scene.getChecksum() << std::dec << std::endl;
+
+	TileSet::unload_all();
+	return 0;
+}
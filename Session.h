@@ -0,0 +1,52 @@
+#pragma once
+#include "SceneEditor.h"
+#include "Binary.h"
+
+/* Records an editing session to a compact file: every use of the terrain tool, every change of the view and every frame,
+ * each with the time elapsed since the previous record. The scene as it was when the recording started is saved next to
+ * the session (<filename>.scene), so that replaying the session onto it rebuilds the same scene. A session already recorded to the
+ * file is moved to <filename>.old (and its scene to <filename>.old.scene) rather than overwritten.
+ * Records are a type byte, the elapsed time in microseconds (varint) and a payload; they are written to the file by blocks.
+ */
+class SessionRecorder {
+public:
+	SessionRecorder(Scene const& scene, TerrainTool const& tool, std::string const& filename);
+	//Writes the remaining records
+	~SessionRecorder();
+
+	SessionRecorder(SessionRecorder const&) = delete;
+	SessionRecorder& operator=(SessionRecorder const&) = delete;
+
+	void recordUse(int x, int y, int z);
+	//Does nothing if the view did not change since the last recorded one
+	void recordView(sf::View const& view);
+	void recordFrame();
+
+	void flush();
+
+	enum RecordType : uchar {
+		use,
+		view,
+		frame
+	};
+
+	//Buffered size past which records are written to the file
+	static const size_t blockSize = 1 << 12;
+
+private:
+	void beginRecord(RecordType type);
+
+	std::string filename;
+	std::ofstream file;
+	BinaryWriter pending;
+	std::chrono::steady_clock::time_point lastRecord;
+
+	sf::Vector2f viewCenter;
+	sf::Vector2f viewSize;
+	float viewRotation = 0;
+	bool viewRecorded = false;
+};
+
+//Command line replay mode (RPG --replay <session> [--realtime]): replays a recorded session onto a new scene without a window,
+//as fast as possible or at the recorded pace, and reports the timings and the checksum of the resulting scene
+int runReplayTool(std::vector<std::string> const& args);
@@ -1,47 +1,62 @@
 #include "TileSet.h"
-#include "json.hpp"
-using json = nlohmann::json;
-
-const std::map<SubTile::SubPosition, sf::FloatRect> SubTile::subPosRects {
-	{ SubTile::full, sf::FloatRect(0, 0, 1, 1) },
-	{ SubTile::tlCorner, sf::FloatRect(0, 0, .5, .5) },
-	{ SubTile::trCorner, sf::FloatRect(.5, 0, .5, .5) },
-	{ SubTile::blCorner, sf::FloatRect(0, .5, .5, .5) },
-	{ SubTile::brCorner, sf::FloatRect(.5, .5, .5, .5) },
-	{ SubTile::topHalf, sf::FloatRect(0, 0, 1, .5) },
-	{ SubTile::botHalf, sf::FloatRect(0, .5, 1, .5) },
-	{ SubTile::leftHalf, sf::FloatRect(0, 0, .5, 1) },
-	{ SubTile::rightHalf, sf::FloatRect(.5, 0, .5, 1) }
+#include "TileSetLoader.h"
+#include "Binary.h"
+#include "Resources.h"
+
+//Binary cache layout: header, source stamp, texture name (with the size and mtime of that texture when it is not the tileset's own png), then per tile its name, category, compatibilities and subtile ranges,
+//then the raw subtile table
+struct TileSetCacheHeader {
+	char magic[4];
+	uint version;
+	uint tileSize;
+	uint n_tiles;
+	uint n_subTiles;
 };
 
-std::map<std::string, std::unique_ptr<TileSet>> TileSet::tileSets {};
+static const char tileSetCacheMagic[4] = { 'R', 'P', 'G', 'T' };
+//Bumped whenever what a cache holds for the same sources changes, e.g. tile IDs being assigned in json file order
+static const uint tileSetCacheVersion = 6;
+
+bool TileSet::cacheEnabled = true;
 
-NLOHMANN_JSON_SERIALIZE_ENUM(Tile::Category, {
-	{Tile::Category::terrain_top, "terrain top"},
-	{Tile::Category::terrain_wall, "terrain wall"},
-	{Tile::Category::terrain_foot, "terrain foot"}
-})
+std::map<std::string, TileSet::Request> TileSet::tileSets {};
+std::mutex TileSet::tileSetsMutex;
 
-NLOHMANN_JSON_SERIALIZE_ENUM(SubTile::Pattern, {
-	{SubTile::Pattern::center, "center"},
-	{SubTile::Pattern::patch, "patch"},
-	{SubTile::Pattern::cross, "cross"},
-	{SubTile::Pattern::horizontal, "horizontal"},
-	{SubTile::Pattern::vertical, "vertical"},
-	{SubTile::Pattern::edges, "edges"}
-})
+std::map<std::string, std::weak_ptr<TileSet::TexturePage>> TileSet::texturePages {};
+std::mutex TileSet::texturePagesMutex;
+
+bool TileSet::Request::isReady() const {
+	return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+TileSet const& TileSet::Request::get() const {
+	TileSet const& set = *future.get();
+	set.uploadTexture();
+	return set;
+}
 
 TileSet const& TileSet::get(std::string const& name) {
+	return getAsync(name).get();
+}
+
+TileSet::Request TileSet::getAsync(std::string const& name) {
+	std::lock_guard lock(tileSetsMutex);
 	auto it = tileSets.find(name);
 	if (it == tileSets.end()) {
-		// unique_ptr takes control of this new; make_ptr cannot be used here due to TileSet's private constructor
-		return *tileSets.emplace(name, new TileSet(name)).first->second;
+		Request request;
+		request.future = std::async(std::launch::async, [name]() {
+			TRACE_THREAD_NAME("tileset loader");
+			// make_shared cannot be used here due to TileSet's private constructor
+			return std::shared_ptr<TileSet>(new TileSet(name));
+		}).share();
+		return tileSets.emplace(name, request).first->second;
 	}
 	else
-		return *it->second;
+		return it->second;
 }
 
 void TileSet::unload(std::string const& name) {
+	std::lock_guard lock(tileSetsMutex);
 	auto it = tileSets.find(name);
 	if (it != tileSets.end()) {
 		tileSets.erase(it);
@@ -52,129 +67,401 @@ void TileSet::unload(std::string const& name) {
 }
 
 void TileSet::unload_all() {
+	std::lock_guard lock(tileSetsMutex);
 	tileSets.clear();
 }
 
-TileSet::TileSet(std::string const& name) {
-	texture = sf::Texture();
-	std::string filename = "resources/" + name + ".png";
-	if (!texture.loadFromFile(filename)) {
-		throw GameError("No texture file found for tileset " + name + " (expected " + filename + ')');
+TileSet::TileSet(std::string const& name) : name(name) {
+	TRACE_ZONE("TileSet::load");
+	std::string pngName = name + ".png";
+	std::string jsonName = name + ".json";
+	std::string textureName;
+
+	//Baked tilesets (see AtlasBaker) come first, then the cache, then the json
+	SourceStamp stamp = SourceStamp::of(jsonName, pngName);
+	if (cacheEnabled && (loadCache("baked/" + name + ".tsb", stamp, textureName) || loadCache(name + ".tsb", stamp, textureName))) {
+		texturePage = loadTexturePage(textureName.empty() ? pngName : textureName);
+		return;
 	}
 
-	filename = "resources/" + name + ".json";
-	std::ifstream ifs(filename);
-	if (!ifs.is_open()) {
-		throw GameError("No json file found for tileset " + name + " (expected " + filename + ')');
+	loadJson(jsonName);
+	texturePage = loadTexturePage(pngName);
+	findOpaqueSubTiles(*texturePage, pngName);
+	//A missing cache only costs a json parse on the next load, so failing to write it is not an error
+	if (cacheEnabled)
+		writeCache(Resources::getPath(name + ".tsb"), stamp, "", tileSize, tiles, subTiles);
+}
+
+std::shared_ptr<TileSet::TexturePage> TileSet::loadTexturePage(std::string const& name) {
+	std::shared_ptr<TexturePage> page;
+	{
+		std::lock_guard lock(texturePagesMutex);
+		std::weak_ptr<TexturePage>& entry = texturePages[name];
+		page = entry.lock();
+		if (!page) {
+			page = std::make_shared<TexturePage>();
+			entry = page;
+		}
 	}
-	json jFile;
-	ifs >> jFile;
-	ifs.close();
 
-	//Returns a vector of coordinate variants
-	auto getCoords = [this](json const& j) {
-		std::vector<sf::Vector2f> v;
-		if (j[0].type_name() == std::string("number")) {
-			v.emplace_back(tileSize * j[0].get<float>(), tileSize * j[1].get<float>());
-			return v;
+	//Decoding is done outside of the registry lock so that different pages decode in parallel
+	std::call_once(page->decoded, [&]() {
+		TRACE_ZONE("TileSet::decodeTexture");
+		ResourceData png;
+		if (!Resources::load(name, png) || !page->image.loadFromMemory(png.data, png.size)) {
+			throw GameError("No texture file found for tileset (expected " + Resources::getPath(name) + ')');
 		}
-		for (auto& coords : j) {
-			v.emplace_back(tileSize * coords[0].get<float>(), tileSize * coords[1].get<float>());
+	});
+	return page;
+}
+
+void TileSet::findOpaqueSubTiles(TexturePage& page, std::string const& pngName) {
+	TRACE_ZONE("TileSet::findOpaqueSubTiles");
+	std::lock_guard lock(page.imageMutex);
+	sf::Image decoded;
+	sf::Image const* image = &page.image;
+	if (image->getSize().x == 0) {
+		ResourceData png;
+		if (!Resources::load(pngName, png) || !decoded.loadFromMemory(png.data, png.size))
+			throw GameError("No texture file found for tileset (expected " + Resources::getPath(pngName) + ')');
+		image = &decoded;
+	}
+
+	sf::Vector2u size = image->getSize();
+	sf::Uint8 const* pixels = image->getPixelsPtr();
+	for (SubTile& st : subTiles) {
+		sf::IntRect rect(st.getTextureRect(tileSize));
+		st.opaque = rect.left + rect.width <= (int) size.x && rect.top + rect.height <= (int) size.y;
+		for (int y = rect.top; y < rect.top + rect.height && st.opaque; y++) {
+			for (int x = rect.left; x < rect.left + rect.width && st.opaque; x++)
+				st.opaque = pixels[((size_t) y * size.x + x) * 4 + 3] == 255;
 		}
-		return v;
-	};
+	}
+}
+
+void TileSet::loadJson(std::string const& jsonName) {
+	TRACE_ZONE("TileSet::loadJson");
+	std::string filename = Resources::getPath(jsonName);
 
-	auto getTextureRect = [this](sf::Vector2f coords, SubTile::SubPosition subPos) {
+	//Packed json is parsed straight from the archive mapping, loose json is streamed from disk
+	ResourceData packed;
+	bool isPacked = Resources::loadArchived(jsonName, packed);
+	std::ifstream ifs;
+	if (!isPacked) {
+		ifs.open(filename);
+		if (!ifs.is_open()) {
+			throw GameError("No json file found for tileset (expected " + filename + ')');
+		}
+	}
+
+	tiles.clear();
+	tileIDsByName.clear();
+	subTiles.clear();
+
+	auto getTexturePos = [this](sf::Vector2f coords, SubTile::SubPosition subPos) {
 		float s = (float) tileSize;
-		sf::FloatRect rect = SubTile::subPosRects.at(subPos);
-		return sf::FloatRect {
-			coords.x + s * rect.left,
-			coords.y + s * rect.top,
-			s * rect.width,
-			s * rect.height
+		SubTile::Rect const& rect = SubTile::subPosRects[subPos];
+		return sf::Vector2<ushort> {
+			(ushort) (s * (coords.x + rect.left)),
+			(ushort) (s * (coords.y + rect.top))
 		};
 	};
 
-	uint currentTileID = 0;
-	uint currentSubTileID = 0;
-
-	auto createSubTiles = [this, &getTextureRect, &currentSubTileID](TileInfo& t,
-										 std::vector<sf::Vector2f> const& coords,
-										 SubTile::Pattern pattern = SubTile::center,
-										 SubTile::SubPosition subPos = SubTile::full) {
-		auto& subTiles = t.subTiles[pattern][subPos];
-		subTiles.reserve(coords.size());
+	auto createSubTiles = [&](TileInfo& t, TileSource const& source, SubTile::Pattern pattern, SubTile::SubPosition subPos) {
+		std::vector<sf::Vector2f> const& coords = source.patternCoords[pattern];
+		if (coords.empty()) {
+			throw GameError("Tile " + t.name + " in " + filename + " has no coords for pattern " + getPatternName(pattern));
+		}
+		TileInfo::SubTileRange& range = t.subTileRanges[pattern][subPos];
+		range.offset = (uint) subTiles.size();
+		range.count = (ushort) coords.size();
 		for (size_t variant = 0; variant < coords.size(); variant++) {
 			SubTile& st = subTiles.emplace_back();
+			st.ID = (uint) subTiles.size() - 1;
 			st.pattern = pattern;
 			st.subPosition = subPos;
-			st.n_variants = coords.size();
-			st.variant = variant;
-			st.textureRect = getTextureRect(coords[variant], subPos);
-			st.ID = currentSubTileID;
-			subTilesByID[currentSubTileID] = &st;
-			currentSubTileID++;
+			st.n_variants = (ushort) coords.size();
+			st.variant = (ushort) variant;
+			st.texturePos = getTexturePos(coords[variant], subPos);
 		}
 	};
 
-	for (auto& [tileName, jTile] : jFile.items()) {
-		TileInfo& t = tiles[tileName];
-		t.name = tileName;
-		t.ID = currentTileID;
-		for (auto& [sCategory, compatName] : jTile["compatibility"].items()) {
-			Tile::Category category = json(sCategory).get<Tile::Category>();
-			t.compatibilities[category] = compatName;
+	auto onTile = [&](TileSource& source) {
+		if (tileIDsByName.count(source.name)) {
+			throw GameError("Tile " + source.name + " is defined twice in " + filename);
+		}
+		if (!source.hasCategory) {
+			throw GameError("Tile " + source.name + " in " + filename + " has no category");
 		}
 
-		t.category = jTile["category"].get<Tile::Category>();
+		TileInfo& t = tiles.emplace_back();
+		t.name = std::move(source.name);
+		t.ID = (uint) tiles.size() - 1;
+		t.category = source.category;
+		t.compatibilities = std::move(source.compatibilities);
+		tileIDsByName[t.name] = t.ID;
+
 		switch (t.category) {
 			case Tile::Category::terrain_top: {
-				for (std::string sPattern : {"center", "patch", "cross", "horizontal", "vertical"}) {
-					SubTile::Pattern ePattern = json(sPattern).get<SubTile::Pattern>();
-					auto coords = getCoords(jTile["patterns"][sPattern]["coords"]);
+				for (SubTile::Pattern pattern : { SubTile::center, SubTile::patch, SubTile::cross, SubTile::horizontal, SubTile::vertical }) {
 					for (SubTile::SubPosition subPos : { SubTile::full, SubTile::tlCorner, SubTile::trCorner, SubTile::blCorner, SubTile::brCorner }) {
-						createSubTiles(t, coords, ePattern, subPos);
+						createSubTiles(t, source, pattern, subPos);
 					}
 				}
 				break;
 			}
 			case Tile::Category::terrain_wall:
 			case Tile::Category::terrain_foot: {
-				auto coords = getCoords(jTile["patterns"]["center"]["coords"]);
-				createSubTiles(t, coords, SubTile::center, SubTile::botHalf);
-				createSubTiles(t, coords, SubTile::center, SubTile::blCorner);
-				createSubTiles(t, coords, SubTile::center, SubTile::brCorner);
-
-				coords = getCoords(jTile["patterns"]["edges"]["coords"]);
-				createSubTiles(t, coords, SubTile::edges, SubTile::botHalf);
-				createSubTiles(t, coords, SubTile::edges, SubTile::blCorner);
-				createSubTiles(t, coords, SubTile::edges, SubTile::brCorner);
+				for (SubTile::Pattern pattern : { SubTile::center, SubTile::edges }) {
+					createSubTiles(t, source, pattern, SubTile::botHalf);
+					createSubTiles(t, source, pattern, SubTile::blCorner);
+					createSubTiles(t, source, pattern, SubTile::brCorner);
+				}
 				break;
 			}
 			default: break;
 		}
+	};
+
+	std::string error;
+	bool parsed = isPacked ? parseTileSetJson(packed.data, packed.size, onTile, error) : parseTileSetJson(ifs, onTile, error);
+	if (!parsed) {
+		throw GameError("Invalid tileset file " + filename + ": " + error);
+	}
+}
+
+TileSet::SourceStamp TileSet::SourceStamp::of(std::string const& jsonName, std::string const& pngName) {
+	SourceStamp stamp {};
+	Resources::stat(jsonName, stamp.jsonSize, stamp.jsonTime);
+	Resources::stat(pngName, stamp.pngSize, stamp.pngTime);
+	return stamp;
+}
+
+bool TileSet::SourceStamp::operator==(SourceStamp const& other) const {
+	return jsonSize == other.jsonSize && jsonTime == other.jsonTime
+		&& pngSize == other.pngSize && pngTime == other.pngTime;
+}
+
+bool TileSet::loadCache(std::string const& cacheName, SourceStamp const& stamp, std::string& textureName) {
+	TRACE_ZONE("TileSet::loadCache");
+	ResourceData cache;
+	if (!Resources::load(cacheName, cache))
+		return false;
+
+	try {
+		BinaryReader reader(cache.data, cache.size);
+		TileSetCacheHeader header = reader.read<TileSetCacheHeader>();
+		if (std::memcmp(header.magic, tileSetCacheMagic, 4) != 0
+			|| header.version != tileSetCacheVersion
+			|| header.tileSize != tileSize
+			|| !(reader.read<SourceStamp>() == stamp))
+			return false;
+		std::string cachedTextureName = reader.readString();
+		//A baked page written again since, by another bake, holds other cells
+		if (!cachedTextureName.empty()) {
+			ulonglong pageSize, pageTime;
+			if (!Resources::stat(cachedTextureName, pageSize, pageTime)
+				|| reader.read<ulonglong>() != pageSize || reader.read<ulonglong>() != pageTime)
+				return false;
+		}
+
+		//Everything read is checked before it replaces the tileset's tables, so that a corrupt cache falls back to the json
+		//instead of leaving subtile ranges pointing out of the table
+		auto isValidCategory = [](Tile::Category category) {
+			return category >= Tile::terrain_top && category <= Tile::terrain_foot;
+		};
+		//Each tile takes at least its name length, category, compatibility count and ranges
+		if (header.n_tiles > reader.remaining() / (sizeof(uint) + 2 + sizeof(TileInfo::subTileRanges)))
+			return false;
+		std::vector<TileInfo> cachedTiles(header.n_tiles);
+		std::map<std::string, uint> cachedIDsByName;
+		for (uint i = 0; i < header.n_tiles; i++) {
+			TileInfo& t = cachedTiles[i];
+			t.ID = i;
+			t.name = reader.readString();
+			t.category = reader.read<Tile::Category>();
+			if (!isValidCategory(t.category))
+				return false;
+			uchar n_compatibilities = reader.read<uchar>();
+			for (uchar c = 0; c < n_compatibilities; c++) {
+				Tile::Category category = reader.read<Tile::Category>();
+				if (!isValidCategory(category))
+					return false;
+				t.compatibilities[category] = reader.readString();
+			}
+			reader.readArray(&t.subTileRanges[0][0], SubTile::n_patterns * SubTile::n_subPositions);
+			for (auto const& patternRanges : t.subTileRanges) {
+				for (TileInfo::SubTileRange const& range : patternRanges) {
+					if ((ulonglong) range.offset + range.count > header.n_subTiles)
+						return false;
+				}
+			}
+			if (!cachedIDsByName.emplace(t.name, i).second)
+				return false;
+		}
 
-		currentTileID++;
+		if (reader.remaining() != (size_t) header.n_subTiles * sizeof(SubTile))
+			return false;
+		std::vector<SubTile> cachedSubTiles(header.n_subTiles);
+		reader.readArray(cachedSubTiles.data(), cachedSubTiles.size());
+		for (uint i = 0; i < header.n_subTiles; i++) {
+			SubTile const& st = cachedSubTiles[i];
+			//Raw bytes only make a valid bool if they are 0 or 1
+			uchar opaque;
+			std::memcpy(&opaque, &st.opaque, 1);
+			if (st.ID != i || st.pattern >= SubTile::n_patterns || st.subPosition >= SubTile::n_subPositions
+				|| st.variant >= st.n_variants || opaque > 1)
+				return false;
+		}
+
+		textureName = std::move(cachedTextureName);
+		tiles = std::move(cachedTiles);
+		tileIDsByName = std::move(cachedIDsByName);
+		subTiles = std::move(cachedSubTiles);
+		return true;
+	}
+	catch (GameError const&) {
+		return false;
 	}
 }
 
+void TileSet::writeCache(std::string const& filename, SourceStamp const& stamp, std::string const& textureName, uint tileSize,
+						 std::vector<TileInfo> const& tiles, std::vector<SubTile> const& subTiles) {
+	BinaryWriter writer;
+	TileSetCacheHeader header {};
+	std::memcpy(header.magic, tileSetCacheMagic, 4);
+	header.version = tileSetCacheVersion;
+	header.tileSize = tileSize;
+	header.n_tiles = (uint) tiles.size();
+	header.n_subTiles = (uint) subTiles.size();
+	writer.write(header);
+	writer.write(stamp);
+	writer.writeString(textureName);
+	if (!textureName.empty()) {
+		ulonglong pageSize = 0, pageTime = 0;
+		Resources::stat(textureName, pageSize, pageTime);
+		writer.write(pageSize);
+		writer.write(pageTime);
+	}
+
+	for (TileInfo const& t : tiles) {
+		writer.writeString(t.name);
+		writer.write(t.category);
+		writer.write((uchar) t.compatibilities.size());
+		for (auto const& [category, compatName] : t.compatibilities) {
+			writer.write(category);
+			writer.writeString(compatName);
+		}
+		writer.writeArray(&t.subTileRanges[0][0], SubTile::n_patterns * SubTile::n_subPositions);
+	}
+	writer.writeArray(subTiles.data(), subTiles.size());
+	writer.saveToFile(filename);
+}
+
+void TileSet::uploadTexture() const {
+	TexturePage& page = *texturePage;
+	std::call_once(page.uploaded, [&page]() {
+		TRACE_ZONE("TileSet::uploadTexture");
+		std::lock_guard lock(page.imageMutex);
+		page.texture.loadFromImage(page.image);
+		page.image = sf::Image();
+	});
+}
+
+std::string const& TileSet::getName() const {
+	return name;
+}
+
 sf::Texture const& TileSet::getTexture() const {
-	return texture;
+	return texturePage->texture;
+}
+
+size_t TileSet::getTileCount() const {
+	return tiles.size();
+}
+
+size_t TileSet::getSubTileCount() const {
+	return subTiles.size();
+}
+
+MemoryReport TileSet::getMemoryReport() const {
+	MemoryReport report;
+	reportMetadata(report);
+	reportTexturePage(*texturePage, report);
+	return report;
+}
+
+MemoryReport TileSet::getLoadedMemoryReport() {
+	std::vector<std::shared_ptr<TileSet>> loaded;
+	{
+		std::lock_guard lock(tileSetsMutex);
+		for (auto const& [name, request] : tileSets) {
+			if (!request.isReady())
+				continue;
+			try {
+				loaded.push_back(request.future.get());
+			}
+			catch (GameError const&) {}
+		}
+	}
+
+	MemoryReport report;
+	std::set<TexturePage const*> pages;
+	for (auto const& tileset : loaded) {
+		tileset->reportMetadata(report);
+		if (pages.insert(tileset->texturePage.get()).second)
+			reportTexturePage(*tileset->texturePage, report);
+	}
+	return report;
+}
+
+void TileSet::reportMetadata(MemoryReport& report) const {
+	size_t bytes = sizeof(TileSet) + MemoryReport::stringHeapBytes(name);
+	bytes += tiles.capacity() * sizeof(TileInfo);
+	for (TileInfo const& info : tiles) {
+		bytes += MemoryReport::stringHeapBytes(info.name);
+		for (auto const& [category, compatible] : info.compatibilities)
+			bytes += sizeof(std::pair<const Tile::Category, std::string>) + MemoryReport::mapNodeOverhead + MemoryReport::stringHeapBytes(compatible);
+	}
+	for (auto const& [tileName, ID] : tileIDsByName)
+		bytes += sizeof(std::pair<const std::string, uint>) + MemoryReport::mapNodeOverhead + MemoryReport::stringHeapBytes(tileName);
+	bytes += subTiles.capacity() * sizeof(SubTile);
+	report.bytes[MemoryReport::tileSetMetadata] += bytes;
+}
+
+void TileSet::reportTexturePage(TexturePage const& page, MemoryReport& report) {
+	sf::Vector2u imageSize = page.image.getSize();
+	sf::Vector2u textureSize = page.texture.getSize();
+	report.bytes[MemoryReport::textureImages] += (size_t) imageSize.x * imageSize.y * 4;
+	report.bytes[MemoryReport::textures] += (size_t) textureSize.x * textureSize.y * 4;
+}
+
+TileInfo const* TileSet::findTileInfo(std::string const& name) const noexcept {
+	auto it = tileIDsByName.find(name);
+	if (it == tileIDsByName.end())
+		return nullptr;
+	return &tiles[it->second];
+}
+
+TileInfo const* TileSet::findTileInfo(uint ID) const noexcept {
+	if (ID < tiles.size())
+		return &tiles[ID];
+	return nullptr;
 }
 
 Tile::Category TileSet::getCategory(std::string const& name) const {
-	auto it = tiles.find(name);
-	if (it != tiles.end()) {
-		return it->second.category;
+	auto it = tileIDsByName.find(name);
+	if (it != tileIDsByName.end()) {
+		return tiles[it->second].category;
 	}
 	throw GameError("Tried to get category of unknown tile " + name + " from tileset");
 }
 
 Tile TileSet::getEmptyTile(std::string const& name) const {
-	auto it = tiles.find(name);
-	if (it != tiles.end()) {
+	auto it = tileIDsByName.find(name);
+	if (it != tileIDsByName.end()) {
 		Tile t;
-		t.info = &it->second;
+		t.info = &tiles[it->second];
 		return t;
 	}
 	throw GameError("Tried to load unknown tile " + name + " from tileset");
@@ -184,35 +471,76 @@ SubTile const* TileSet::getSubTile(std::string const& name,
 							  SubTile::Pattern pattern,
 							  SubTile::SubPosition subPos,
 							  size_t variant) const {
-	try {
-		return &tiles.at(name).subTiles.at(pattern).at(subPos).at(variant);
-	}
-	catch (std::out_of_range) {
-		throw GameError("Tried to load invalid subtile from " + name
-			+ " (pattern " + json(pattern).get<std::string>() + ", subposition " + std::to_string(subPos)
-			+ ", variant " + std::to_string(variant) + ')');
-	}
+	SubTile const* st = findSubTile(name, pattern, subPos, variant);
+	if (st == nullptr)
+		throwInvalidSubTile(name, pattern, subPos, variant);
+	return st;
 }
 
 SubTile const* TileSet::getSubTile(Tile const& tile,
 							  SubTile::Pattern pattern,
 							  SubTile::SubPosition subPos,
 							  size_t variant) const {
-	try {
-		return &tile.info->subTiles.at(pattern).at(subPos).at(variant);
-	}
-	catch (std::out_of_range) {
-		throw GameError("Tried to load invalid subtile from " + tile.info->name
-			+ " (pattern " + json(pattern).get<std::string>() + ", subposition " + std::to_string(subPos)
-			+ ", variant " + std::to_string(variant) + ')');
-	}
+	SubTile const* st = findSubTile(*tile.info, pattern, subPos, variant);
+	if (st == nullptr)
+		throwInvalidSubTile(tile.info->name, pattern, subPos, variant);
+	return st;
 }
 
 SubTile const* TileSet::getSubTile(uint ID) const {
-	try {
-		return subTilesByID.at(ID);
-	}
-	catch (std::out_of_range) {
+	SubTile const* st = findSubTile(ID);
+	if (st == nullptr)
 		throw GameError("Tried to load invalid subtile of ID " + std::to_string(ID));
-	}
-}
\ No newline at end of file
+	return st;
+}
+
+SubTile const* TileSet::findSubTile(std::string const& name,
+							   SubTile::Pattern pattern,
+							   SubTile::SubPosition subPos,
+							   size_t variant) const noexcept {
+	auto it = tileIDsByName.find(name);
+	if (it == tileIDsByName.end())
+		return nullptr;
+	return findSubTile(tiles[it->second], pattern, subPos, variant);
+}
+
+SubTile const* TileSet::findSubTile(Tile const& tile,
+							   SubTile::Pattern pattern,
+							   SubTile::SubPosition subPos,
+							   size_t variant) const noexcept {
+	if (tile.info == nullptr)
+		return nullptr;
+	return findSubTile(*tile.info, pattern, subPos, variant);
+}
+
+SubTile const* TileSet::findSubTile(uint ID) const noexcept {
+	if (ID < subTiles.size())
+		return &subTiles[ID];
+	return nullptr;
+}
+
+SubTile const* TileSet::findSubTile(TileInfo const& info, SubTile::Pattern pattern, SubTile::SubPosition subPos, size_t variant) const noexcept {
+	if (pattern >= SubTile::n_patterns || subPos >= SubTile::n_subPositions)
+		return nullptr;
+	TileInfo::SubTileRange const& range = info.subTileRanges[pattern][subPos];
+	if (variant >= range.count)
+		return nullptr;
+	return &subTiles[range.offset + variant];
+}
+
+void TileSet::throwInvalidSubTile(std::string const& name, SubTile::Pattern pattern, SubTile::SubPosition subPos, size_t variant) {
+	throw GameError("Tried to load invalid subtile from " + name
+		+ " (pattern " + getPatternName(pattern) + ", subposition " + std::to_string(subPos)
+		+ ", variant " + std::to_string(variant) + ')');
+}
+
+sf::FloatRect SubTile::getTextureRect(uint tileSize) const {
+	float s = (float) tileSize;
+	Rect const& rect = subPosRects[subPosition];
+	return sf::FloatRect {
+		(float) texturePos.x,
+		(float) texturePos.y,
+		s * rect.width,
+		s * rect.height
+	};
+}
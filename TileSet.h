@@ -1,12 +1,13 @@
 #pragma once
 #include "json.hpp"
+#include "MemoryReport.h"
 
 struct SubTile {
-	uint ID; //Unique for every subtile; used for saving / loading scenes
+	uint ID; //Unique for every subtile; used for saving / loading scenes. Also its index in the tileset's subtile table
 
 	//Pattern used in the texture file
 	//This can have different meanings depending on the tile category (e.g. "center" for paths and walls)
-	enum Pattern {
+	enum Pattern : uchar {
 		center,
 		patch,
 		cross,
@@ -15,11 +16,8 @@ struct SubTile {
 		edges
 	} pattern = Pattern::center;
 
-	size_t variant;			//Variant of the pattern used (for texture variety)		
-	size_t n_variants;		//Number of available variants of the pattern
-
 	//Which part of the pattern is used in this subtile
-	enum SubPosition {
+	enum SubPosition : uchar {
 		full,
 		tlCorner,
 		trCorner,
@@ -31,11 +29,62 @@ struct SubTile {
 		rightHalf
 	} subPosition = SubPosition::full;
 
-	static const std::map<SubTile::SubPosition, sf::FloatRect> subPosRects;
-	
-	sf::FloatRect textureRect;
+	//Every texel of the subtile is opaque, so it hides whatever was drawn under it before; read from the texture when the json is loaded
+	bool opaque = false;
+
+	ushort variant;			//Variant of the pattern used (for texture variety)
+	ushort n_variants;		//Number of available variants of the pattern
+
+	sf::Vector2<ushort> texturePos; //Top left corner of the subtile in the texture, in pixels
+
+	static const size_t n_patterns = 6;
+	static const size_t n_subPositions = 9;
+
+	//Area covered by each subposition inside its tile, in tile units; indexed by SubPosition
+	struct Rect {
+		float left, top, width, height;
+	};
+
+	static constexpr Rect subPosRects[n_subPositions] = {
+		{ 0, 0, 1, 1 },		//full
+		{ 0, 0, .5, .5 },	//tlCorner
+		{ .5, 0, .5, .5 },	//trCorner
+		{ 0, .5, .5, .5 },	//blCorner
+		{ .5, .5, .5, .5 },	//brCorner
+		{ 0, 0, 1, .5 },	//topHalf
+		{ 0, .5, 1, .5 },	//botHalf
+		{ 0, 0, .5, 1 },	//leftHalf
+		{ .5, 0, .5, 1 }	//rightHalf
+	};
+
+	sf::FloatRect getTextureRect(uint tileSize) const;
 };
 
+//Vertices of the two triangles drawing a subtile, ordered top left, top right, bottom left, bottom left, top right, bottom right
+struct SubTileQuad {
+	float x[6], y[6];	//Positions relative to the tile's top left corner, in tile units
+	float u[6], v[6];	//Texture coordinates relative to the subtile's texturePos, in tile units
+};
+
+constexpr std::array<SubTileQuad, SubTile::n_subPositions> makeSubTileQuads() {
+	constexpr float cornerX[6] = { 0, 1, 0, 0, 1, 1 };
+	constexpr float cornerY[6] = { 0, 0, 1, 1, 0, 1 };
+	std::array<SubTileQuad, SubTile::n_subPositions> quads {};
+	for (size_t p = 0; p < SubTile::n_subPositions; p++) {
+		SubTile::Rect const& r = SubTile::subPosRects[p];
+		for (size_t i = 0; i < 6; i++) {
+			quads[p].x[i] = r.left + cornerX[i] * r.width;
+			quads[p].y[i] = r.top + cornerY[i] * r.height;
+			quads[p].u[i] = cornerX[i] * r.width;
+			quads[p].v[i] = cornerY[i] * r.height;
+		}
+	}
+	return quads;
+}
+
+//Quad vertex templates, indexed by SubPosition
+inline constexpr std::array<SubTileQuad, SubTile::n_subPositions> subTileQuads = makeSubTileQuads();
+
 struct TileInfo;
 
 struct Tile {
@@ -52,24 +101,54 @@ struct Tile {
 
 struct TileInfo { //Stores information about a tile such as its possible subtiles
 	std::string name;
-	uint ID; //Unique for every subtile; used for saving / loading scenes
+	uint ID; //Unique for every tile; used for saving / loading scenes. Also its index in the tileset's tile table
 
 	Tile::Category category;
 
 	std::map<Tile::Category, std::string> compatibilities;
 
-	//Search is done by pattern, then subposition, then variant
-	std::map<SubTile::Pattern, std::map<SubTile::SubPosition, std::vector<SubTile>>> subTiles;
+	//Location of the variants of a pattern / subposition combination in the tileset's subtile table
+	struct SubTileRange {
+		uint offset = 0;
+		ushort count = 0;
+	};
+
+	//Search is done by pattern, then subposition; variants are contiguous from the range's offset
+	SubTileRange subTileRanges[SubTile::n_patterns][SubTile::n_subPositions];
 };
 
 class TileSet {
 public:
+	//Handle on a tileset loading in the background
+	class Request {
+	public:
+		//True once the image is decoded and the metadata parsed
+		bool isReady() const;
+
+		//Waits for the background work if needed, then uploads the texture. Must be called from the GL thread.
+		TileSet const& get() const;
+
+	private:
+		friend class TileSet;
+		std::shared_future<std::shared_ptr<TileSet>> future;
+	};
+
+	//Loading functions are safe to call from any thread; get() must be called from the GL thread
 	static TileSet const& get(std::string const& name);
+	static Request getAsync(std::string const& name);
 	static void unload(std::string const& name);
 	static void unload_all();
 
+	std::string const& getName() const;
 	sf::Texture const& getTexture() const;
 
+	size_t getTileCount() const;
+	size_t getSubTileCount() const;
+
+	//Return nullptr if the tile does not exist
+	TileInfo const* findTileInfo(std::string const& name) const noexcept;
+	TileInfo const* findTileInfo(uint ID) const noexcept;
+
 	Tile::Category getCategory(std::string const& name) const;
 
 	Tile getEmptyTile(std::string const& name) const;
@@ -86,15 +165,86 @@ public:
 
 	SubTile const* getSubTile(uint ID) const;
 
+	//Non-throwing versions of getSubTile; return nullptr if the subtile does not exist
+	SubTile const* findSubTile(std::string const& name,
+							   SubTile::Pattern pattern = SubTile::Pattern::center,
+							   SubTile::SubPosition subPos = SubTile::SubPosition::full,
+							   size_t variant = 0) const noexcept;
+
+	SubTile const* findSubTile(Tile const& tile,
+							   SubTile::Pattern pattern = SubTile::Pattern::center,
+							   SubTile::SubPosition subPos = SubTile::SubPosition::full,
+							   size_t variant = 0) const noexcept;
+
+	SubTile const* findSubTile(uint ID) const noexcept;
+
 	const uint tileSize = 24;
 
+	//Whether baked tilesets and the binary metadata cache next to the json file are used; if not, the json is always parsed
+	static bool cacheEnabled;
+
+	//Memory used by the metadata and the texture page; a page shared with other tilesets is counted in full
+	MemoryReport getMemoryReport() const;
+	//Memory used by every loaded tileset, counting shared texture pages once
+	static MemoryReport getLoadedMemoryReport();
+
 private:
+	friend class AtlasBaker;
+
 	TileSet(std::string const& name);
 
-	sf::Texture texture;
+	//Identifies the version of the source files a binary cache was built from
+	struct SourceStamp {
+		ulonglong jsonSize, jsonTime;
+		ulonglong pngSize, pngTime;
+
+		static SourceStamp of(std::string const& jsonName, std::string const& pngName);
+		bool operator==(SourceStamp const& other) const;
+	};
+
+	//Resource names are relative to the resources directory
+	void loadJson(std::string const& jsonName);
+
+	//Baked tilesets and caches share the same format; the texture name is empty when it is the tileset's own png.
+	//Another texture is stamped with its size and mtime, so it must be written before the cache.
+	bool loadCache(std::string const& cacheName, SourceStamp const& stamp, std::string& textureName);
+	static void writeCache(std::string const& filename, SourceStamp const& stamp, std::string const& textureName, uint tileSize,
+						   std::vector<TileInfo> const& tiles, std::vector<SubTile> const& subTiles);
+
+	SubTile const* findSubTile(TileInfo const& info, SubTile::Pattern pattern, SubTile::SubPosition subPos, size_t variant) const noexcept;
+
+	//Kept out of line so that the error message construction stays off the lookup path
+	[[noreturn]] static void throwInvalidSubTile(std::string const& name, SubTile::Pattern pattern, SubTile::SubPosition subPos, size_t variant);
+
+	//A texture shared by every tileset drawn from it (e.g. several tilesets baked into one atlas page).
+	//The image is decoded on a loading thread and only turned into a texture on the GL thread.
+	struct TexturePage {
+		sf::Image image;
+		sf::Texture texture;
+		std::once_flag decoded;
+		std::once_flag uploaded;
+		//Held to read the image after decoding, as another tileset drawn from the page can upload it and drop the image
+		std::mutex imageMutex;
+	};
+
+	static std::shared_ptr<TexturePage> loadTexturePage(std::string const& name);
+	//Sets SubTile::opaque from the alpha of the texels of each subtile; the png is decoded again if the page was uploaded already
+	void findOpaqueSubTiles(TexturePage& page, std::string const& pngName);
+	void uploadTexture() const;
+
+	void reportMetadata(MemoryReport& report) const;
+	static void reportTexturePage(TexturePage const& page, MemoryReport& report);
+
+	std::string name;
+	std::shared_ptr<TexturePage> texturePage;
+
+	std::vector<TileInfo> tiles;					//Indexed by TileInfo::ID
+	std::map<std::string, uint> tileIDsByName;
+	std::vector<SubTile> subTiles;				//Indexed by SubTile::ID
 
-	std::map<std::string, TileInfo> tiles;
-	std::map<uint, SubTile*> subTilesByID;
+	static std::map<std::string, Request> tileSets;
+	static std::mutex tileSetsMutex;
 
-	static std::map<std::string, std::unique_ptr<TileSet>> tileSets;
+	static std::map<std::string, std::weak_ptr<TexturePage>> texturePages;
+	static std::mutex texturePagesMutex;
 };
\ No newline at end of file
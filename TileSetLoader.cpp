@@ -0,0 +1,174 @@
+#include "TileSetLoader.h"
+#include "json.hpp"
+using json = nlohmann::json;
+
+static const std::pair<char const*, Tile::Category> categoryNames[] = {
+	{ "terrain top", Tile::terrain_top },
+	{ "terrain wall", Tile::terrain_wall },
+	{ "terrain foot", Tile::terrain_foot }
+};
+
+static const std::pair<char const*, SubTile::Pattern> patternNames[] = {
+	{ "center", SubTile::center },
+	{ "patch", SubTile::patch },
+	{ "cross", SubTile::cross },
+	{ "horizontal", SubTile::horizontal },
+	{ "vertical", SubTile::vertical },
+	{ "edges", SubTile::edges }
+};
+
+template<class E, size_t N>
+static bool parseName(std::pair<char const*, E> const (&names)[N], std::string const& name, E& value) {
+	for (auto const& [n, v] : names) {
+		if (name == n) {
+			value = v;
+			return true;
+		}
+	}
+	return false;
+}
+
+template<class E, size_t N>
+static char const* getName(std::pair<char const*, E> const (&names)[N], E value) {
+	for (auto const& [n, v] : names) {
+		if (v == value)
+			return n;
+	}
+	return "unknown";
+}
+
+bool parseCategoryName(std::string const& name, Tile::Category& category) {
+	return parseName(categoryNames, name, category);
+}
+
+bool parsePatternName(std::string const& name, SubTile::Pattern& pattern) {
+	return parseName(patternNames, name, pattern);
+}
+
+char const* getCategoryName(Tile::Category category) {
+	return getName(categoryNames, category);
+}
+
+char const* getPatternName(SubTile::Pattern pattern) {
+	return getName(patternNames, pattern);
+}
+
+/* Expected layout:
+ * { "<tile name>": {
+ *     "category": "<category>",
+ *     "compatibility": { "<category>": "<tile name>", ... },
+ *     "patterns": { "<pattern>": { "coords": [x, y] or [[x, y], ...] }, ... }
+ * }, ... }
+ * Unknown keys are skipped.
+ */
+class TileSetSaxHandler : public nlohmann::json_sax<json> {
+public:
+	TileSetSaxHandler(std::function<void(TileSource&)> const& onTile, std::string& error) : onTile(onTile), error(error) {}
+
+	bool null() override { return true; }
+	bool boolean(bool) override { return true; }
+	bool number_integer(number_integer_t val) override { return number((float) val); }
+	bool number_unsigned(number_unsigned_t val) override { return number((float) val); }
+	bool number_float(number_float_t val, string_t const&) override { return number((float) val); }
+	bool binary(binary_t&) override { return true; }
+
+	bool string(string_t& val) override {
+		if (depth == 2 && keys[2] == "category") {
+			if (!parseCategoryName(val, tile.category))
+				return fail("unknown category \"" + val + '"');
+			tile.hasCategory = true;
+		}
+		else if (depth == 3 && keys[2] == "compatibility") {
+			Tile::Category category;
+			if (!parseCategoryName(keys[3], category))
+				return fail("unknown compatibility category \"" + keys[3] + '"');
+			tile.compatibilities[category] = val;
+		}
+		return true;
+	}
+
+	bool key(string_t& val) override {
+		if (depth < maxDepth)
+			keys[depth] = val;
+		return true;
+	}
+
+	bool start_object(std::size_t) override {
+		if (coordsDepth > 0)
+			return fail("unexpected object in coords");
+		depth++;
+		if (depth == 2) {
+			tile = TileSource();
+			tile.name = keys[1];
+		}
+		return true;
+	}
+
+	bool end_object() override {
+		if (depth == 2)
+			onTile(tile);
+		depth--;
+		return true;
+	}
+
+	bool start_array(std::size_t) override {
+		if (coordsDepth > 0 || (depth == 4 && keys[2] == "patterns" && keys[4] == "coords")) {
+			if (coordsDepth == 0)
+				numbers.clear();
+			coordsDepth++;
+		}
+		return true;
+	}
+
+	bool end_array() override {
+		if (coordsDepth > 0 && --coordsDepth == 0) {
+			SubTile::Pattern pattern;
+			if (!parsePatternName(keys[3], pattern))
+				return fail("unknown pattern \"" + keys[3] + '"');
+			if (numbers.empty() || numbers.size() % 2 != 0)
+				return fail("coords of pattern \"" + keys[3] + "\" are not a list of (x, y) pairs");
+			auto& coords = tile.patternCoords[pattern];
+			coords.clear();
+			for (size_t i = 0; i < numbers.size(); i += 2)
+				coords.emplace_back(numbers[i], numbers[i + 1]);
+		}
+		return true;
+	}
+
+	bool parse_error(std::size_t, std::string const&, nlohmann::detail::exception const& ex) override {
+		return fail(ex.what());
+	}
+
+private:
+	bool number(float val) {
+		if (coordsDepth > 0)
+			numbers.push_back(val);
+		return true;
+	}
+
+	bool fail(std::string const& message) {
+		error = (tile.name.empty() ? "" : "tile " + tile.name + ": ") + message;
+		return false;
+	}
+
+	//Object nesting: 1 is the root, 2 a tile, 3 a tile field, 4 a pattern
+	static const int maxDepth = 5;
+	int depth = 0;
+	std::string keys[maxDepth];	//Current key at each object depth
+	int coordsDepth = 0;		//Array nesting inside a "coords" value
+	std::vector<float> numbers;
+
+	TileSource tile;
+	std::function<void(TileSource&)> const& onTile;
+	std::string& error;
+};
+
+bool parseTileSetJson(std::istream& is, std::function<void(TileSource&)> const& onTile, std::string& error) {
+	TileSetSaxHandler handler(onTile, error);
+	return json::sax_parse(is, &handler);
+}
+
+bool parseTileSetJson(char const* data, size_t size, std::function<void(TileSource&)> const& onTile, std::string& error) {
+	TileSetSaxHandler handler(onTile, error);
+	return json::sax_parse(data, data + size, &handler);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "TileSet.h"
+
+//Everything read from the json description of one tile, before its subtiles are built
+struct TileSource {
+	std::string name;
+	bool hasCategory = false;
+	Tile::Category category = Tile::terrain_top;
+	std::map<Tile::Category, std::string> compatibilities;
+	std::vector<sf::Vector2f> patternCoords[SubTile::n_patterns]; //Coordinate variants of each pattern, in tile units
+};
+
+//Streams a tileset json file, calling onTile as soon as each tile has been read.
+//Only one tile is held in memory at a time. Returns false and fills error if the json is malformed.
+bool parseTileSetJson(std::istream& is, std::function<void(TileSource&)> const& onTile, std::string& error);
+bool parseTileSetJson(char const* data, size_t size, std::function<void(TileSource&)> const& onTile, std::string& error);
+
+//String / enum conversions for the names used in tileset files
+bool parseCategoryName(std::string const& name, Tile::Category& category);
+bool parsePatternName(std::string const& name, SubTile::Pattern& pattern);
+char const* getCategoryName(Tile::Category category);
+char const* getPatternName(SubTile::Pattern pattern);
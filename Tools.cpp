@@ -5,18 +5,29 @@ sf::Color randomColor() {
 }
 
 sf::Vector2u indexToCoords(uint i, sf::Vector2u size) {
-	sf::Vector2u coords;
-	coords.x = i % size.x;
-	coords.y = i / size.x;
-	if (coords.x >= size.x || coords.y >= size.y) {
-		throw GameError("Tried to convert out of range index to coordinates: " + vec2ToString(coords) + " over size " + vec2ToString(size));
+	std::optional<sf::Vector2u> coords = tryIndexToCoords(i, size);
+	if (!coords) {
+		throw GameError("Tried to convert out of range index to coordinates: " + std::to_string(i) + " over size " + vec2ToString(size));
 	}
-	return coords;
+	return *coords;
 }
 
 uint coordsToIndex(sf::Vector2u coords, sf::Vector2u size) {
-	if (coords.x >= size.x || coords.y >= size.y) {
+	std::optional<uint> i = tryCoordsToIndex(coords, size);
+	if (!i) {
 		throw GameError("Tried to convert out of range coordinates to index: " + vec2ToString(coords) + " over size " + vec2ToString(size));
 	}
+	return *i;
+}
+
+std::optional<sf::Vector2u> tryIndexToCoords(uint i, sf::Vector2u size) noexcept {
+	if (size.x == 0 || i / size.x >= size.y)
+		return std::nullopt;
+	return sf::Vector2u(i % size.x, i / size.x);
+}
+
+std::optional<uint> tryCoordsToIndex(sf::Vector2u coords, sf::Vector2u size) noexcept {
+	if (coords.x >= size.x || coords.y >= size.y)
+		return std::nullopt;
 	return coords.x + size.x * coords.y;
 }
\ No newline at end of file
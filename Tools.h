@@ -14,4 +14,9 @@ sf::Color randomColor();
 
 sf::Vector2u indexToCoords(uint i, sf::Vector2u size);
 
-uint coordsToIndex(sf::Vector2u coords, sf::Vector2u size);
\ No newline at end of file
+uint coordsToIndex(sf::Vector2u coords, sf::Vector2u size);
+
+//Non-throwing versions of the above; return an empty optional if out of range
+std::optional<sf::Vector2u> tryIndexToCoords(uint i, sf::Vector2u size) noexcept;
+
+std::optional<uint> tryCoordsToIndex(sf::Vector2u coords, sf::Vector2u size) noexcept;
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include <iomanip>
+#include "Trace.h"
+
+#ifdef RPG_TRACE
+
+namespace {
+	struct Event {
+		char const* name;
+		longlong start, duration;	//Nanoseconds since the start of the trace
+		uint recursion;
+	};
+
+	struct ThreadBuffer {
+		uint id;
+		std::string name;
+
+		//Grows up to the capacity, then wraps around
+		std::vector<Event> events;
+		size_t next = 0;
+		//Only contended while exporting
+		std::mutex mutex;
+
+		//Names of the open zones, to find recursions
+		std::vector<char const*> openZones;
+	};
+
+	const auto traceStart = std::chrono::steady_clock::now();
+
+	std::mutex buffersMutex;
+	//Buffers outlive their threads so that short-lived threads can still be exported
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+	longlong now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceStart).count();
+	}
+
+	ThreadBuffer& threadBuffer() {
+		thread_local std::shared_ptr<ThreadBuffer> buffer = []() {
+			auto created = std::make_shared<ThreadBuffer>();
+			created->events.reserve(Trace::bufferCapacity);
+			created->openZones.reserve(Trace::maxZoneDepth);
+			std::lock_guard lock(buffersMutex);
+			created->id = (uint) buffers.size();
+			created->name = "thread " + std::to_string(created->id);
+			buffers.push_back(created);
+			return created;
+		}();
+		return *buffer;
+	}
+
+	void writeString(std::ostream& os, std::string const& s) {
+		os << '"';
+		for (char c : s) {
+			if (c == '"' || c == '\\')
+				os << '\\';
+			os << c;
+		}
+		os << '"';
+	}
+}
+
+Trace::Zone::Zone(char const* name) : name(name), recursion(0) {
+	ThreadBuffer& buffer = threadBuffer();
+	if (buffer.openZones.size() >= maxZoneDepth) {
+		this->name = nullptr;
+		return;
+	}
+	for (char const* open : buffer.openZones)
+		recursion += open == name;
+	buffer.openZones.push_back(name);
+	start = now();
+}
+
+Trace::Zone::~Zone() {
+	if (name == nullptr)
+		return;
+	longlong end = now();
+	ThreadBuffer& buffer = threadBuffer();
+	buffer.openZones.pop_back();
+
+	Event event{ name, start, end - start, recursion };
+	std::lock_guard lock(buffer.mutex);
+	if (buffer.events.size() < bufferCapacity)
+		buffer.events.push_back(event);
+	else
+		buffer.events[buffer.next] = event;
+	buffer.next = (buffer.next + 1) % bufferCapacity;
+}
+
+void Trace::setThreadName(std::string const& name) {
+	ThreadBuffer& buffer = threadBuffer();
+	std::lock_guard lock(buffer.mutex);
+	buffer.name = name;
+}
+
+bool Trace::exportJson(std::string const& filename) {
+	std::vector<std::shared_ptr<ThreadBuffer>> exported;
+	{
+		std::lock_guard lock(buffersMutex);
+		exported = buffers;
+	}
+
+	std::ofstream ofs(filename, std::ios::trunc);
+	if (!ofs.is_open())
+		return false;
+
+	//Timestamps are in microseconds
+	ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	for (auto const& buffer : exported) {
+		std::vector<Event> events;
+		std::string threadName;
+		{
+			std::lock_guard lock(buffer->mutex);
+			events = buffer->events;
+			threadName = buffer->name;
+		}
+
+		ofs << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+		writeString(ofs, threadName);
+		ofs << "}}";
+		first = false;
+
+		for (Event const& event : events) {
+			ofs << ",\n{\"name\":";
+			writeString(ofs, event.name);
+			ofs << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->id
+				<< ",\"ts\":" << event.start / 1000 << '.' << std::setw(3) << std::setfill('0') << event.start % 1000
+				<< ",\"dur\":" << event.duration / 1000 << '.' << std::setw(3) << std::setfill('0') << event.duration % 1000;
+			if (event.recursion > 0)
+				ofs << ",\"args\":{\"recursion\":" << event.recursion << '}';
+			ofs << '}';
+		}
+	}
+	ofs << "\n]}\n";
+	return ofs.good();
+}
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+/* Scoped trace zones, exported as Chrome trace events (open the file in chrome://tracing or ui.perfetto.dev).
+ * Everything compiles out unless RPG_TRACE is defined.
+ * Each thread records into its own ring buffer, which overwrites its oldest events once full.
+ * Zone names must be string literals. Zones nested in a zone of the same name record their recursion depth.
+ */
+#ifdef RPG_TRACE
+
+namespace Trace {
+	class Zone {
+	public:
+		explicit Zone(char const* name);
+		~Zone();
+
+		Zone(Zone const&) = delete;
+		Zone& operator=(Zone const&) = delete;
+
+	private:
+		char const* name;
+		longlong start;
+		uint recursion;
+	};
+
+	void setThreadName(std::string const& name);
+
+	//Writes the events held by every thread's buffer; returns false if the file cannot be written
+	bool exportJson(std::string const& filename);
+
+	//Events kept per thread
+	const size_t bufferCapacity = 1 << 16;
+	//Zones nested deeper are not recorded, so that opening and closing zones never allocates once a thread's buffer exists
+	const size_t maxZoneDepth = 64;
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(traceZone_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+#define TRACE_EXPORT(filename) Trace::exportJson(filename)
+
+#else
+
+#define TRACE_ZONE(name) ((void) 0)
+#define TRACE_THREAD_NAME(name) ((void) 0)
+#define TRACE_EXPORT(filename) ((void) 0)
+
+#endif